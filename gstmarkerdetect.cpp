@@ -22,6 +22,8 @@
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
 #include "gstmarkerdetect.h"
+#include "gstmarkerdetectmeta.h"
+#include "gstmarkerdetectsampling.h"
 
 /* OpenCV header files */
 #include <opencv2/core.hpp>
@@ -32,9 +34,56 @@
 /* Aruco Markers */
 #include <opencv2/aruco.hpp>
 
+#include <algorithm>
+#include <cfloat>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#ifdef MARKERDETECT_COUNT_ALLOCATIONS
+#include <dlfcn.h>
+#endif
+
+/* OpenCV 4.7 moved ArUco into objdetect, with a reusable detector object */
+#if (CV_VERSION_MAJOR > 4) || ((CV_VERSION_MAJOR == 4) && (CV_VERSION_MINOR >= 7))
+#define MARKERDETECT_HAVE_ARUCO_DETECTOR 1
+#endif
+
 GST_DEBUG_CATEGORY_STATIC (gst_markerdetect_debug_category);
 #define GST_CAT_DEFAULT gst_markerdetect_debug_category
 
+//
+// Allocation counter (debug builds)
+//
+// Built with -DMARKERDETECT_COUNT_ALLOCATIONS (make COUNT_ALLOCATIONS=1), the
+// element reads the heap allocation count of the calling thread from
+// libmarkerdetectalloc.so (test/allocations_preload.c), preloaded to
+// interpose malloc : operator new, cv::Mat buffers, the ArUco detector and
+// GLib are all counted. OpenCV's parallel_for_ bodies are run on the calling
+// thread (cv::setNumThreads(0)) so that they are counted too. Past the first
+// 50 frames, any allocation on the frame path is reported as a warning, and
+// counted in the stats structure (heap-allocations) for
+// test/allocations_markerdetect.py.
+//
+#ifdef MARKERDETECT_COUNT_ALLOCATIONS
+static unsigned long long (*gst_markerdetect_heap_allocations) (void) = NULL;
+
+#define GST_MARKERDETECT_ALLOCATIONS()                \
+  ((guint64) (gst_markerdetect_heap_allocations ? gst_markerdetect_heap_allocations() : 0))
+#else
+#define GST_MARKERDETECT_ALLOCATIONS()                ((guint64) 0)
+#endif
+
 /* prototypes */
 
 
@@ -53,6 +102,28 @@ static GstFlowReturn gst_markerdetect_transform_frame (GstVideoFilter * filter,
     GstVideoFrame * inframe, GstVideoFrame * outframe);
 static GstFlowReturn gst_markerdetect_transform_frame_ip (GstVideoFilter * filter,
     GstVideoFrame * frame);
+static GstFlowReturn gst_markerdetect_prepare_output_buffer (GstBaseTransform * trans,
+    GstBuffer * input, GstBuffer ** outbuf);
+static gboolean gst_markerdetect_sink_event (GstBaseTransform * trans, GstEvent * event);
+static GstPad *gst_markerdetect_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps);
+static void gst_markerdetect_release_pad (GstElement * element, GstPad * pad);
+static void gst_markerdetect_start_worker (GstMarkerDetect *markerdetect);
+static void gst_markerdetect_stop_worker (GstMarkerDetect *markerdetect);
+static void gst_markerdetect_group_leave (GstMarkerDetect *markerdetect);
+static void gst_markerdetect_run_script (gpointer data, gpointer user_data);
+typedef struct _GstMarkerDetectCoprocess GstMarkerDetectCoprocess;
+static void gst_markerdetect_coprocess_start (GstMarkerDetect *markerdetect, GstMarkerDetectCoprocess *coprocess,
+    gchar **script, gchar **extra_args, const gchar *name);
+static void gst_markerdetect_coprocess_stop (GstMarkerDetectCoprocess *coprocess);
+
+enum
+{
+  SIGNAL_MEASURED,
+  LAST_SIGNAL
+};
+
+static guint gst_markerdetect_signals[LAST_SIGNAL] = { 0 };
 
 enum
 {
@@ -64,18 +135,739 @@ enum
   PROP_CC_SHOW_EC, // error color code (GnYlRd)
   PROP_WB_SCRIPT,
   PROP_WB_EXTRA_ARGS,
-  PROP_WB_SKIP_FRAMES
+  PROP_WB_SKIP_FRAMES,
+  PROP_DICTIONARY,
+  PROP_ADAPTIVE_THRESH_WIN_SIZE_MIN,
+  PROP_ADAPTIVE_THRESH_WIN_SIZE_MAX,
+  PROP_ADAPTIVE_THRESH_WIN_SIZE_STEP,
+  PROP_MIN_MARKER_PERIMETER_RATE,
+  PROP_MAX_MARKER_PERIMETER_RATE,
+  PROP_CORNER_REFINEMENT_METHOD,
+  PROP_REDUCED_DICTIONARY,
+  PROP_DETECT_SCALE,
+  PROP_DETECT_TILES,
+  PROP_TRACK,
+  PROP_TRACK_REACQUIRE_INTERVAL,
+  PROP_TRACK_PADDING,
+  PROP_DETECT_INTERVAL,
+  PROP_MOTION_THRESHOLD,
+  PROP_PRESENCE_FILTER,
+  PROP_PRESENCE_SCAN_INTERVAL,
+  PROP_ASYNC,
+  PROP_QUEUE_DEPTH,
+  PROP_WORKER_CPU,
+  PROP_DELTA_E,
+  PROP_POST_MESSAGES,
+  PROP_SCRIPT_MODE,
+  PROP_ATTACH_META,
+  PROP_OVERLAY,
+  PROP_OVERLAY_REFRESH_INTERVAL,
+  PROP_STATS_INTERVAL,
+  PROP_STATS,
+  PROP_WORKER_POOL,
+  PROP_GROUP
+};
+
+/* default detector settings (same as cv::aruco::DetectorParameters) */
+#define DEFAULT_DICTIONARY                    cv::aruco::DICT_ARUCO_ORIGINAL
+#define DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_MIN  3
+#define DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_MAX  23
+#define DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_STEP 10
+#define DEFAULT_MIN_MARKER_PERIMETER_RATE     0.03
+#define DEFAULT_MAX_MARKER_PERIMETER_RATE     4.0
+#define DEFAULT_CORNER_REFINEMENT_METHOD      cv::aruco::CORNER_REFINE_NONE
+#define DEFAULT_REDUCED_DICTIONARY            FALSE
+#define DEFAULT_DETECT_SCALE                  1
+#define DEFAULT_DETECT_TILES                  1
+#define DEFAULT_TRACK                         FALSE
+#define DEFAULT_TRACK_REACQUIRE_INTERVAL      30
+#define DEFAULT_TRACK_PADDING                 0.5
+#define DEFAULT_DETECT_INTERVAL               1
+#define DEFAULT_MOTION_THRESHOLD              4.0
+#define DEFAULT_PRESENCE_FILTER               FALSE
+#define DEFAULT_PRESENCE_SCAN_INTERVAL        30
+
+/* motion check : NxN luma samples inside each corner marker */
+#define GST_MARKERDETECT_MOTION_GRID          8
+
+/* presence filter : working image size (largest side), and smallest threshold window half-size in it */
+#define GST_MARKERDETECT_PRESENCE_SIZE        320
+#define GST_MARKERDETECT_PRESENCE_MIN_WINDOW  3
+
+/* overlay drawing : longest label (with its terminator), most polygon points */
+#define GST_MARKERDETECT_LABEL_SIZE           64
+#define GST_MARKERDETECT_POLYGON_MAX          8
+
+/* co-process record : 24x3 values of up to 11 characters, and their separators */
+#define GST_MARKERDETECT_RECORD_SIZE          (24*3*12)
+
+/* text layer : glyphs of chart 1 (a label per patch, 4 per color space), and the atlas slot of each
+   (fits a 64 character label in the 1.0 Hershey plain font, longer ones are cut) */
+#define GST_MARKERDETECT_TEXT_GLYPHS          (24 + 5*4)
+#define GST_MARKERDETECT_TEXT_SLOT_WIDTH      256
+#define GST_MARKERDETECT_TEXT_SLOT_HEIGHT     24
+
+/* patch sampling : total patch area (pixels) from which the 24 patches are sampled in parallel
+   (the 24 50x50 reference patches of a chart about 640 pixels wide) */
+#define GST_MARKERDETECT_PARALLEL_SAMPLING_AREA  (64 * 1024)
+
+/* default analysis worker settings */
+#define DEFAULT_ASYNC                         FALSE
+#define DEFAULT_QUEUE_DEPTH                   2
+#define DEFAULT_WORKER_CPU                    -1
+
+/* where async analysis runs */
+enum
+{
+  GST_MARKERDETECT_WORKER_POOL_PRIVATE,
+  GST_MARKERDETECT_WORKER_POOL_SHARED
+};
+#define DEFAULT_WORKER_POOL                   GST_MARKERDETECT_WORKER_POOL_PRIVATE
+#define DEFAULT_GROUP                         NULL
+
+/* group members whose last Color Checker measurement is older than this are ignored (us) */
+#define GST_MARKERDETECT_GROUP_MAX_AGE        (5 * G_USEC_PER_SEC)
+
+/* color difference used for the Lab chart error */
+enum
+{
+  GST_MARKERDETECT_DELTA_E_CIE76,
+  GST_MARKERDETECT_DELTA_E_CIEDE2000
+};
+#define DEFAULT_DELTA_E                       GST_MARKERDETECT_DELTA_E_CIE76
+#define DEFAULT_POST_MESSAGES                 TRUE
+#define DEFAULT_ATTACH_META                   TRUE
+
+/* what is drawn on the frames */
+enum
+{
+  GST_MARKERDETECT_OVERLAY_NONE,
+  GST_MARKERDETECT_OVERLAY_MARKERS,
+  GST_MARKERDETECT_OVERLAY_FULL
+};
+#define DEFAULT_OVERLAY                       GST_MARKERDETECT_OVERLAY_FULL
+#define DEFAULT_OVERLAY_REFRESH_INTERVAL      1
+
+/* stage timing is off by default */
+#define DEFAULT_STATS_INTERVAL                0
+
+/* how cc-script/wb-script are run */
+enum
+{
+  GST_MARKERDETECT_SCRIPT_MODE_SPAWN,
+  GST_MARKERDETECT_SCRIPT_MODE_COPROCESS
+};
+#define DEFAULT_SCRIPT_MODE                   GST_MARKERDETECT_SCRIPT_MODE_SPAWN
+
+/* marker IDs used by the charts (top left, top right, bottom left, bottom right) */
+static const int chartMarkerIds[] = {
+  923, 1001, 1002, 1003, 1004, 1005, 1006, 1007, 241
+};
+
+// Reference coordinates manually taken from 608x512 image (ROI from ArUco markers)
+#define GST_MARKERDETECT_CHART_WIDTH          608
+#define GST_MARKERDETECT_CHART_HEIGHT         512
+static const cv::Point2f arucoCornersRef[4] = {
+  {  0,  0}, {607,  0}, {607,511}, {  0,511}
+};
+static const cv::Point2f chartCornersRef[4] = {
+  {  0, 57}, {607, 57}, {607,455}, {  0,455}
+};
+static const cv::Point2f chartCentroidsRef[24] = {
+  { 46,103}, {150,103}, {252,103}, {355,103}, {458,103}, {561,103},
+  { 46,205}, {150,205}, {252,205}, {355,205}, {458,205}, {561,205},
+  { 46,307}, {150,307}, {252,307}, {355,307}, {458,307}, {561,307},
+  { 46,409}, {150,409}, {252,409}, {355,409}, {458,409}, {561,409}
+};
+// Reference width/height of color patches is approximately 89/88, so take safe subset of this
+static const float colorPatchFullWidth = 88.0;
+static const float colorPatchFullHeight = 88.0;
+static const float colorPatchWidth = 50.0;
+static const float colorPatchHeight = 50.0;
+
+// Ground Truth BGR values for 24 Color Patches
+//std::vector<std::array<float, 3>> chartColorsRef =
+static const cv::Scalar chartColorsRef[24] =
+{ 
+// Dark Skin      Light Skin     Blue Sky       Foliage        Blue Flower    Bluish Green   
+  { 68, 82,115}, {130,150,192}, {157,122, 98}, { 67,108, 87}, {177,128,133}, {170,189,103},
+// Orange         Purple Red     Moderate Red   Purple         Yellow Green   Orange Yello
+  { 44,126,214}, {166, 91, 80}, { 99, 90,193}, {108, 60, 94}, { 64,188,157}, { 46,163,224},
+// Blue           Green          Red            Yellow         Magenta        Cyan
+  {150, 61, 56}, { 73,148, 70}, { 60, 54,175}, { 31,199,231}, {149, 86,187}, {161,133,  8},
+// White          Neutral 8      Neutral 65     Neutral 5      Neutral 35     Black
+  {242,243,243}, {200,200,200}, {160,160,160}, {121,122,122}, { 85, 85, 85}, { 52, 52, 52}
+};
+
+// BGR values for GrYlRd colormap
+// (generated with colormap_GrYlRd.py)
+static const cv::Scalar colormap_GrYlRd[] =
+{
+   {   58 ,  111 ,    4  },
+   {   62 ,  119 ,    8  },
+   {   66 ,  126 ,   12  },
+   {   71 ,  136 ,   17  },
+   {   75 ,  143 ,   21  },
+   {   79 ,  151 ,   25  },
+   {   82 ,  157 ,   36  },
+   {   86 ,  164 ,   51  },
+   {   89 ,  170 ,   63  },
+   {   92 ,  175 ,   75  },
+   {   95 ,  181 ,   87  },
+   {   99 ,  189 ,  102  },
+   {  100 ,  193 ,  112  },
+   {  101 ,  197 ,  122  },
+   {  102 ,  202 ,  132  },
+   {  103 ,  207 ,  144  },
+   {  104 ,  212 ,  154  },
+   {  105 ,  216 ,  164  },
+   {  111 ,  220 ,  175  },
+   {  117 ,  224 ,  183  },
+   {  122 ,  227 ,  191  },
+   {  127 ,  231 ,  199  },
+   {  133 ,  235 ,  209  },
+   {  139 ,  239 ,  217  },
+   {  147 ,  241 ,  222  },
+   {  155 ,  244 ,  228  },
+   {  165 ,  247 ,  236  },
+   {  173 ,  249 ,  242  },
+   {  181 ,  252 ,  248  },
+   {  189 ,  254 ,  254  },
+   {  181 ,  249 ,  254  },
+   {  173 ,  244 ,  254  },
+   {  165 ,  239 ,  254  },
+   {  155 ,  233 ,  254  },
+   {  147 ,  228 ,  254  },
+   {  139 ,  224 ,  254  },
+   {  132 ,  216 ,  253  },
+   {  124 ,  206 ,  253  },
+   {  117 ,  198 ,  253  },
+   {  110 ,  190 ,  253  },
+   {  104 ,  182 ,  253  },
+   {   96 ,  172 ,  252  },
+   {   91 ,  162 ,  251  },
+   {   86 ,  152 ,  250  },
+   {   82 ,  142 ,  248  },
+   {   76 ,  129 ,  246  },
+   {   71 ,  119 ,  245  },
+   {   67 ,  109 ,  244  },
+   {   61 ,   97 ,  238  },
+   {   57 ,   87 ,  233  },
+   {   52 ,   77 ,  229  },
+   {   48 ,   68 ,  224  },
+   {   42 ,   56 ,  218  },
+   {   38 ,   47 ,  214  },
+   {   38 ,   39 ,  206  },
+   {   38 ,   32 ,  198  },
+   {   38 ,   22 ,  188  },
+   {   38 ,   15 ,  180  },
+   {   38 ,    7 ,  172  },
+   {   38 ,    0 ,  165  }
+};
+
+/* video frame wrapped with OpenCV Mats (views on the frame planes, no copies) */
+typedef struct
+{
+  GstVideoFormat format;
+  int width;
+  int height;
+  cv::Mat bgr;     /* BGR : packed BGR plane */
+  cv::Mat luma;    /* NV12/GRAY8 : Y plane, YUY2 : Y extracted at detection time */
+  cv::Mat chroma;  /* NV12 : UV plane (CV_8UC2, half size), YUY2 : YUYV pairs (CV_8UC4, half width) */
+} GstMarkerDetectImage;
+
+/* analysis result of a frame (plain values, so it can be handed over between threads) */
+typedef struct
+{
+  std::vector<int> markerIds;
+  std::vector<std::vector<cv::Point2f>> markerCorners;
+  int chart;                            /* 0 (none), 1001, 1002 or 1003 */
+  cv::Point2f tl_xy, tr_xy, bl_xy, br_xy;
+  cv::Matx33d homography;               /* chart reference coordinates to frame */
+  /* chart 1001 : color checker */
+  cv::Point2f chartCorners[4];
+  cv::Point2f patchCorners[24][4];
+  cv::Point2f halfPatchCorners[24][4];
+  cv::Scalar patchMeans[24];
+  float patchErrorYUV[24];
+  float chartErrors[5][4];              /* BGR, YUV, LAB, HSV, XYZ : total, then per component */
+  int groupSize;                        /* cameras of the group measured (this one included) */
+  float groupDeltas[24];                /* patch distance (BGR) to the group average */
+  /* chart 1002 : white reference */
+  cv::Scalar wbMean;
+  /* chart 1003 : histograms */
+  int histCount;
+  float hist[3][256];
+} GstMarkerDetectResult;
+
+/* what the cached Color Checker text layer shows (plain ints, compared as a whole) */
+typedef struct
+{
+  unsigned patchErrors[24];             /* E[UV] per patch */
+  unsigned chartErrors[5][4];           /* per color space : total, then per component */
+  int showErrors;                       /* cc-show-ec */
+  int deltaE;
+} GstMarkerDetectTextKey;
+
+/* a label rendered in the text layer : its coverage in the atlas, and its box from the text origin */
+typedef struct
+{
+  cv::Rect roi;
+  cv::Point offset;
+} GstMarkerDetectGlyph;
+
+/* script co-process, fed by a writer thread */
+struct _GstMarkerDetectCoprocess
+{
+  GstMarkerDetect *markerdetect;
+  gchar **script;                       /* script and extra argument properties */
+  gchar **extra_args;
+  gint fd;                              /* co-process stdin (-1 when not running) */
+  gint64 spawnTime;
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  bool stop;
+  bool hasRecord;                       /* record waiting to be written */
+  std::string record;
+  guint64 dropped;
+};
+
+/* detector context (persists across frames, rebuilt when detector properties change) */
+struct _GstMarkerDetectContext
+{
+#ifdef MARKERDETECT_HAVE_ARUCO_DETECTOR
+  cv::aruco::ArucoDetector detector;
+#else
+  cv::Ptr<cv::aruco::Dictionary> dictionary;
+  cv::Ptr<cv::aruco::DetectorParameters> parameters;
+#endif
+  /* reduced dictionary index => original marker ID (empty when not in use) */
+  std::vector<int> markerIdMap;
+
+  /* BGR <=> YUV conversion for the negotiated colorimetry */
+  double Kr, Kb;
+  double yuvOffset[3];
+  double yuvScale[3];
+
+  /* tracked corner markers (by role : top left, top right, bottom left, bottom right) */
+  bool trackValid;
+  unsigned trackFrames;
+  int trackIds[4];
+  cv::Point2f trackCorners[4][4];
+  cv::Point2f trackCenter[4];
+  cv::Point2f trackVelocity[4];
+  std::vector<int> roiIds;
+  std::vector<std::vector<cv::Point2f>> roiCorners;
+
+  /* decimated detection image (detect-scale), and BGR => gray corner refinement window */
+  cv::Mat detectImage;
+  cv::Mat refineImage;
+
+  /* presence filter : downscaled image, its binarization and contours, frames skipped since the last full scan */
+  cv::Mat presenceImage;
+  cv::Mat1b presenceGray;
+  cv::Mat1b presenceBinary;
+  std::vector<std::vector<cv::Point>> presenceContours;
+  std::vector<cv::Point> presenceQuad;
+  unsigned presenceSkipped;
+
+  /* tiles and per tile detections (detect-tiles), and the merged detections' distance to their tile border */
+  std::vector<cv::Rect> tiles;
+  std::vector<float> tileBorderDistance;
+  std::vector<std::vector<int>> tileIds;
+  std::vector<std::vector<std::vector<cv::Point2f>>> tileCorners;
+  std::vector<std::vector<std::vector<cv::Point2f>>> tileRejected;
+
+  /* chart geometry reused between detections (detect-interval),
+     and the marker luma samples of the detected frame (motion check) */
+  bool geometryValid;
+  unsigned geometryAge;
+  int geometryWidth, geometryHeight;
+  GstMarkerDetectResult geometry;
+  std::vector<cv::Point> motionPoints;
+  std::vector<uchar> motionRef;
+
+  /* YUY2 luma, drawing scratch (sized in set_info), and the chart plots */
+  cv::Mat yuy2Luma;
+  cv::Mat1b drawMask;
+  cv::Mat drawImage;
+  cv::Mat plotImage;
+  cv::Mat histImage;
+  cv::Mat histNorm;
+
+  /* overlay label text (capacity reserved in set_info), and the group name of the last measurement */
+  std::string label;
+  std::string groupName;
+
+  /* Color Checker text layer : values latched every overlay-refresh-interval frames,
+     the key its glyphs were rendered for, and the glyph coverages (one atlas slot per glyph) */
+  bool textLatched;
+  unsigned textAge;
+  GstMarkerDetectTextKey textValues;
+  bool textValid;
+  GstMarkerDetectTextKey textKey;
+  cv::Mat1b textAtlas;
+  GstMarkerDetectGlyph textGlyphs[GST_MARKERDETECT_TEXT_GLYPHS];
+
+  /* Color Checker ground truth in each color space (converted once), and the measured patch colors */
+  cv::Mat3f refBGR, refYUV, refLab, refHSV, refXYZ;
+  cv::Mat3f patchBGR, patchScaled, patchYUV, patchLab, patchHSV, patchXYZ;
+
+  /* detection results, kept here so their storage is reused from frame to frame */
+  std::vector<int> markerIds;
+  std::vector<std::vector<cv::Point2f>> markerCorners, rejectedCandidates;
+
+  /* analysis worker (async) : owns the detector state above, the streaming thread owns the drawing scratch.
+     With worker-pool=shared, there is no private worker : the frames are analyzed by the shared pool */
+  bool async;
+  bool pooled;
+  bool analyzing;                       /* a shared pool thread is analyzing a frame (pool lock) */
+  GThread *worker;
+  GMutex jobLock;
+  GCond jobCond;
+  bool workerStop;
+  std::vector<GstMarkerDetectImage *> jobQueue;     /* oldest first (a few entries, reserved up front) */
+  std::vector<GstMarkerDetectImage *> freeJobs;
+  guint64 droppedFrames;
+  GstMarkerDetectResult workerResult;
+  GstMarkerDetectResult latestResult;
+  guint64 resultSerial;
+
+  /* chart scripts are run off the streaming/analysis threads, one run at a time per script
+     (cc and wb have their own queue), or run continuously as co-processes (script-mode=coprocess) */
+  GThreadPool *ccScriptPool;
+  GThreadPool *wbScriptPool;
+  GstMarkerDetectCoprocess ccCoprocess;
+  GstMarkerDetectCoprocess wbCoprocess;
+
+  /* result overlaid on the frames */
+  GstMarkerDetectResult drawResult;
+  guint64 drawnSerial;
+
+  /* frames since start, for stats-interval */
+  guint64 statsFrames;
+
+  /* chart_src : output buffers, and the remap tables of the last homography
+     (full resolution plane, and subsampled chroma plane of NV12/YUY2) */
+  GstBufferPool *chartPool;
+  GstVideoInfo chartInfo;
+  bool chartMapValid;
+  GstVideoFormat chartMapFormat;
+  cv::Matx33d chartMapH;
+  cv::Mat chartMap1, chartMap2;
+  cv::Mat chartSubMap1, chartSubMap2;
+  cv::Mat2f chartMapF;                  /* float table scratch, chart sized */
+};
+
+//
+// Stage timing (stats-interval > 0)
+//
+// Each frame accumulates the time spent in each stage in a GstMarkerDetectTiming
+// (on the stack of the analyzing or drawing thread), then commits it to the
+// rolling windows of the element in one go. With stats-interval=0, the clock is
+// never read.
+//
+
+enum
+{
+  GST_MARKERDETECT_STAGE_DETECT,
+  GST_MARKERDETECT_STAGE_HOMOGRAPHY,
+  GST_MARKERDETECT_STAGE_SAMPLING,
+  GST_MARKERDETECT_STAGE_COLOR,
+  GST_MARKERDETECT_STAGE_PUBLISH,
+  GST_MARKERDETECT_STAGE_OVERLAY,
+  GST_MARKERDETECT_STAGE_FRAME,
+  GST_MARKERDETECT_N_STAGES
+};
+
+static const char *const stageNames[GST_MARKERDETECT_N_STAGES] = {
+  "detect", "homography", "sampling", "color", "publish", "overlay", "frame"
+};
+
+/* stats field names of each stage : <stage>-p50, -p95, -p99, -max (quarks built in class_init) */
+enum
+{
+  GST_MARKERDETECT_STAT_P50,
+  GST_MARKERDETECT_STAT_P95,
+  GST_MARKERDETECT_STAT_P99,
+  GST_MARKERDETECT_STAT_MAX,
+  GST_MARKERDETECT_N_STATS
 };
 
+static const char *const statSuffixes[GST_MARKERDETECT_N_STATS] = { "p50", "p95", "p99", "max" };
+static GQuark statFields[GST_MARKERDETECT_N_STAGES][GST_MARKERDETECT_N_STATS];
+
+/* samples kept per stage for the percentiles */
+#define GST_MARKERDETECT_STATS_WINDOW 256
+
+struct _GstMarkerDetectStats
+{
+  GMutex lock;
+  guint64 frames;
+  guint64 charts;                       /* analyzed frames with a chart */
+  guint64 allocations;                  /* heap allocations past the first frames (MARKERDETECT_COUNT_ALLOCATIONS) */
+  guint64 droppedScripts;               /* script runs skipped while the previous run of the same script was pending */
+  struct
+  {
+    GstClockTime samples[GST_MARKERDETECT_STATS_WINDOW];
+    guint count;
+    guint pos;
+  } stage[GST_MARKERDETECT_N_STAGES];
+};
+
+/* stage times of one frame */
+typedef struct
+{
+  bool enabled;
+  bool chart;                           /* a chart was found (analysis) */
+  unsigned ran;                         /* bit mask of the stages that ran */
+  GstClockTime time[GST_MARKERDETECT_N_STAGES];
+  guint64 allocations;                  /* heap allocations (MARKERDETECT_COUNT_ALLOCATIONS) */
+} GstMarkerDetectTiming;
+
+static inline void
+gst_markerdetect_timing_init (GstMarkerDetect *markerdetect, GstMarkerDetectTiming *timing)
+{
+  timing->enabled = (markerdetect->stats_interval > 0);
+  timing->chart = false;
+  timing->ran = 0;
+  for ( int i = 0; i < GST_MARKERDETECT_N_STAGES; i++ )
+    timing->time[i] = 0;
+  timing->allocations = 0;
+}
+
+static inline GstClockTime
+gst_markerdetect_timing_start (const GstMarkerDetectTiming *timing)
+{
+  return timing->enabled ? gst_util_get_timestamp() : 0;
+}
+
+static inline void
+gst_markerdetect_timing_stop (GstMarkerDetectTiming *timing, int stage, GstClockTime start)
+{
+  if ( timing->enabled )
+  {
+    timing->time[stage] += gst_util_get_timestamp() - start;
+    timing->ran |= 1u << stage;
+  }
+}
+
+/* add the stages that ran to the rolling windows */
+static void
+gst_markerdetect_timing_commit (GstMarkerDetect *markerdetect, const GstMarkerDetectTiming *timing)
+{
+  GstMarkerDetectStats *stats = markerdetect->stats;
+
+  if ( !timing->enabled || timing->ran == 0 )
+    return;
+
+  g_mutex_lock (&stats->lock);
+  for ( int i = 0; i < GST_MARKERDETECT_N_STAGES; i++ )
+  {
+    if ( timing->ran & (1u << i) )
+    {
+      auto &window = stats->stage[i];
+      window.samples[window.pos] = timing->time[i];
+      window.pos = (window.pos + 1) % GST_MARKERDETECT_STATS_WINDOW;
+      if ( window.count < GST_MARKERDETECT_STATS_WINDOW )
+        window.count++;
+    }
+  }
+  if ( timing->ran & (1u << GST_MARKERDETECT_STAGE_FRAME) )
+    stats->frames++;
+  if ( timing->chart )
+    stats->charts++;
+  stats->allocations += timing->allocations;
+  g_mutex_unlock (&stats->lock);
+}
+
+/* account the heap allocations of a frame, and report them once past the first frames
+   (always 0 without the counter) */
+static inline void
+gst_markerdetect_check_allocations (GstMarkerDetect *markerdetect, GstMarkerDetectTiming *timing,
+    guint64 allocations, const char *what)
+{
+  if ( markerdetect->iterations <= 50 )
+    return;
+  timing->allocations += allocations;
+  if ( allocations > 0 )
+  {
+    GST_WARNING_OBJECT (markerdetect, "%" G_GUINT64_FORMAT " heap allocation(s) while %s frame %u",
+        allocations, what, markerdetect->iterations);
+  }
+}
+
+/* p50/p95/p99/max of each stage (nanoseconds) over the rolling windows */
+static GstStructure *
+gst_markerdetect_stats_structure (GstMarkerDetect *markerdetect)
+{
+  GstMarkerDetectStats *stats = markerdetect->stats;
+  GstClockTime sorted[GST_MARKERDETECT_STATS_WINDOW];
+
+  GstStructure *s = gst_structure_new_empty("markerdetect-stats");
+  g_mutex_lock (&stats->lock);
+  gst_structure_set(s, "frames", G_TYPE_UINT64, stats->frames, "charts", G_TYPE_UINT64, stats->charts,
+      "dropped-script-runs", G_TYPE_UINT64, stats->droppedScripts, NULL);
+#ifdef MARKERDETECT_COUNT_ALLOCATIONS
+  if ( gst_markerdetect_heap_allocations != NULL )
+    gst_structure_set(s, "heap-allocations", G_TYPE_UINT64, stats->allocations, NULL);
+#endif
+  for ( int i = 0; i < GST_MARKERDETECT_N_STAGES; i++ )
+  {
+    const auto &window = stats->stage[i];
+    if ( window.count == 0 )
+      continue;
+    std::copy(window.samples, window.samples + window.count, sorted);
+    std::sort(sorted, sorted + window.count);
+    const guint last = window.count - 1;
+    gst_structure_id_set(s,
+      statFields[i][GST_MARKERDETECT_STAT_P50], G_TYPE_UINT64, sorted[(last * 50) / 100],
+      statFields[i][GST_MARKERDETECT_STAT_P95], G_TYPE_UINT64, sorted[(last * 95) / 100],
+      statFields[i][GST_MARKERDETECT_STAT_P99], G_TYPE_UINT64, sorted[(last * 99) / 100],
+      statFields[i][GST_MARKERDETECT_STAT_MAX], G_TYPE_UINT64, sorted[last],
+      NULL);
+  }
+  g_mutex_unlock (&stats->lock);
+
+  return s;
+}
+
+#define GST_TYPE_MARKERDETECT_DICTIONARY (gst_markerdetect_dictionary_get_type())
+static GType
+gst_markerdetect_dictionary_get_type (void)
+{
+  static GType dictionary_type = 0;
+  static const GEnumValue dictionaries[] = {
+    {cv::aruco::DICT_4X4_50, "4x4 bits, 50 markers", "4x4-50"},
+    {cv::aruco::DICT_4X4_100, "4x4 bits, 100 markers", "4x4-100"},
+    {cv::aruco::DICT_4X4_250, "4x4 bits, 250 markers", "4x4-250"},
+    {cv::aruco::DICT_4X4_1000, "4x4 bits, 1000 markers", "4x4-1000"},
+    {cv::aruco::DICT_5X5_50, "5x5 bits, 50 markers", "5x5-50"},
+    {cv::aruco::DICT_5X5_100, "5x5 bits, 100 markers", "5x5-100"},
+    {cv::aruco::DICT_5X5_250, "5x5 bits, 250 markers", "5x5-250"},
+    {cv::aruco::DICT_5X5_1000, "5x5 bits, 1000 markers", "5x5-1000"},
+    {cv::aruco::DICT_6X6_50, "6x6 bits, 50 markers", "6x6-50"},
+    {cv::aruco::DICT_6X6_100, "6x6 bits, 100 markers", "6x6-100"},
+    {cv::aruco::DICT_6X6_250, "6x6 bits, 250 markers", "6x6-250"},
+    {cv::aruco::DICT_6X6_1000, "6x6 bits, 1000 markers", "6x6-1000"},
+    {cv::aruco::DICT_7X7_50, "7x7 bits, 50 markers", "7x7-50"},
+    {cv::aruco::DICT_7X7_100, "7x7 bits, 100 markers", "7x7-100"},
+    {cv::aruco::DICT_7X7_250, "7x7 bits, 250 markers", "7x7-250"},
+    {cv::aruco::DICT_7X7_1000, "7x7 bits, 1000 markers", "7x7-1000"},
+    {cv::aruco::DICT_ARUCO_ORIGINAL, "Original ArUco (5x5 bits, 1024 markers)", "aruco-original"},
+    {0, NULL, NULL},
+  };
+
+  if (!dictionary_type) {
+    dictionary_type =
+        g_enum_register_static ("GstMarkerDetectDictionary", dictionaries);
+  }
+  return dictionary_type;
+}
+
+#define GST_TYPE_MARKERDETECT_CORNER_REFINEMENT (gst_markerdetect_corner_refinement_get_type())
+static GType
+gst_markerdetect_corner_refinement_get_type (void)
+{
+  static GType corner_refinement_type = 0;
+  static const GEnumValue methods[] = {
+    {cv::aruco::CORNER_REFINE_NONE, "No corner refinement", "none"},
+    {cv::aruco::CORNER_REFINE_SUBPIX, "Subpixel refinement", "subpix"},
+    {cv::aruco::CORNER_REFINE_CONTOUR, "Contour line fitting", "contour"},
+    {cv::aruco::CORNER_REFINE_APRILTAG, "AprilTag refinement", "apriltag"},
+    {0, NULL, NULL},
+  };
+
+  if (!corner_refinement_type) {
+    corner_refinement_type =
+        g_enum_register_static ("GstMarkerDetectCornerRefinement", methods);
+  }
+  return corner_refinement_type;
+}
+
+#define GST_TYPE_MARKERDETECT_DELTA_E (gst_markerdetect_delta_e_get_type())
+static GType
+gst_markerdetect_delta_e_get_type (void)
+{
+  static GType delta_e_type = 0;
+  static const GEnumValue metrics[] = {
+    {GST_MARKERDETECT_DELTA_E_CIE76, "CIE76 (euclidean distance in Lab)", "cie76"},
+    {GST_MARKERDETECT_DELTA_E_CIEDE2000, "CIEDE2000", "ciede2000"},
+    {0, NULL, NULL},
+  };
+
+  if (!delta_e_type) {
+    delta_e_type =
+        g_enum_register_static ("GstMarkerDetectDeltaE", metrics);
+  }
+  return delta_e_type;
+}
+
+#define GST_TYPE_MARKERDETECT_WORKER_POOL (gst_markerdetect_worker_pool_get_type())
+static GType
+gst_markerdetect_worker_pool_get_type (void)
+{
+  static GType worker_pool_type = 0;
+  static const GEnumValue pools[] = {
+    {GST_MARKERDETECT_WORKER_POOL_PRIVATE, "One analysis thread for this element", "private"},
+    {GST_MARKERDETECT_WORKER_POOL_SHARED, "Analysis threads (one per core) shared by all elements", "shared"},
+    {0, NULL, NULL},
+  };
+
+  if (!worker_pool_type) {
+    worker_pool_type =
+        g_enum_register_static ("GstMarkerDetectWorkerPool", pools);
+  }
+  return worker_pool_type;
+}
+
+#define GST_TYPE_MARKERDETECT_SCRIPT_MODE (gst_markerdetect_script_mode_get_type())
+static GType
+gst_markerdetect_script_mode_get_type (void)
+{
+  static GType script_mode_type = 0;
+  static const GEnumValue modes[] = {
+    {GST_MARKERDETECT_SCRIPT_MODE_SPAWN, "Run the script for each measurement (values as arguments)", "spawn"},
+    {GST_MARKERDETECT_SCRIPT_MODE_COPROCESS, "Run the script once, one line of values per measurement on its stdin", "coprocess"},
+    {0, NULL, NULL},
+  };
+
+  if (!script_mode_type) {
+    script_mode_type =
+        g_enum_register_static ("GstMarkerDetectScriptMode", modes);
+  }
+  return script_mode_type;
+}
+
+#define GST_TYPE_MARKERDETECT_OVERLAY (gst_markerdetect_overlay_get_type())
+static GType
+gst_markerdetect_overlay_get_type (void)
+{
+  static GType overlay_type = 0;
+  static const GEnumValue overlays[] = {
+    {GST_MARKERDETECT_OVERLAY_NONE, "No overlay (analysis only, read-only passthrough)", "none"},
+    {GST_MARKERDETECT_OVERLAY_MARKERS, "Detected markers only", "markers"},
+    {GST_MARKERDETECT_OVERLAY_FULL, "Markers and chart results", "full"},
+    {0, NULL, NULL},
+  };
+
+  if (!overlay_type) {
+    overlay_type =
+        g_enum_register_static ("GstMarkerDetectOverlay", overlays);
+  }
+  return overlay_type;
+}
+
 /* pad templates */
 
 /* Input format */
 #define VIDEO_SRC_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ BGR }")
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, GRAY8 }")
 
 /* Output format */
 #define VIDEO_SINK_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ BGR }")
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, GRAY8 }")
 
 
 /* class initialization */
@@ -91,6 +883,16 @@ gst_markerdetect_class_init (GstMarkerDetectClass * klass)
   GstBaseTransformClass *base_transform_class = GST_BASE_TRANSFORM_CLASS (klass);
   GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
 
+  for ( int i = 0; i < GST_MARKERDETECT_N_STAGES; i++ )
+  {
+    for ( int j = 0; j < GST_MARKERDETECT_N_STATS; j++ )
+    {
+      char field[32];
+      snprintf(field, sizeof(field), "%s-%s", stageNames[i], statSuffixes[j]);
+      statFields[i][j] = g_quark_from_string(field);
+    }
+  }
+
   /* Setting up pads and setting metadata should be moved to
      base_class_init if you intend to subclass this class. */
   gst_element_class_add_pad_template (GST_ELEMENT_CLASS(klass),
@@ -101,6 +903,9 @@ gst_markerdetect_class_init (GstMarkerDetectClass * klass)
     gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
       //gst_caps_from_string (VIDEO_SINK_CAPS ", width = (int) [1, 1920], height = (int) [1, 1080]")));
       gst_caps_from_string (VIDEO_SINK_CAPS ", width = (int) [1, 3840], height = (int) [1, 2160]")));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS(klass),
+    gst_pad_template_new ("chart_src", GST_PAD_SRC, GST_PAD_REQUEST,
+      gst_caps_from_string (VIDEO_SRC_CAPS ", width = (int) 608, height = (int) 512")));
 
   gst_element_class_set_static_metadata (GST_ELEMENT_CLASS(klass),
     "Marker detection using the OpenCV Library", 
@@ -158,11 +963,207 @@ gst_markerdetect_class_init (GstMarkerDetectClass * klass)
           "White Balance skip frames.", 0, G_MAXINT,
           0,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DICTIONARY,
+      g_param_spec_enum ("dictionary", "dictionary",
+          "ArUco marker dictionary.",
+          GST_TYPE_MARKERDETECT_DICTIONARY, DEFAULT_DICTIONARY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ADAPTIVE_THRESH_WIN_SIZE_MIN,
+      g_param_spec_int ("adaptive-thresh-win-size-min", "adaptive-thresh-win-size-min",
+          "Minimum window size for adaptive thresholding.", 3, G_MAXINT,
+          DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_MIN,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ADAPTIVE_THRESH_WIN_SIZE_MAX,
+      g_param_spec_int ("adaptive-thresh-win-size-max", "adaptive-thresh-win-size-max",
+          "Maximum window size for adaptive thresholding.", 3, G_MAXINT,
+          DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_MAX,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ADAPTIVE_THRESH_WIN_SIZE_STEP,
+      g_param_spec_int ("adaptive-thresh-win-size-step", "adaptive-thresh-win-size-step",
+          "Window size increment for adaptive thresholding.", 1, G_MAXINT,
+          DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_STEP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MIN_MARKER_PERIMETER_RATE,
+      g_param_spec_double ("min-marker-perimeter-rate", "min-marker-perimeter-rate",
+          "Minimum marker perimeter (relative to largest image dimension).", 0.0, G_MAXDOUBLE,
+          DEFAULT_MIN_MARKER_PERIMETER_RATE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_MARKER_PERIMETER_RATE,
+      g_param_spec_double ("max-marker-perimeter-rate", "max-marker-perimeter-rate",
+          "Maximum marker perimeter (relative to largest image dimension).", 0.0, G_MAXDOUBLE,
+          DEFAULT_MAX_MARKER_PERIMETER_RATE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_CORNER_REFINEMENT_METHOD,
+      g_param_spec_enum ("corner-refinement-method", "corner-refinement-method",
+          "ArUco marker corner refinement method.",
+          GST_TYPE_MARKERDETECT_CORNER_REFINEMENT, DEFAULT_CORNER_REFINEMENT_METHOD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_REDUCED_DICTIONARY,
+      g_param_spec_boolean ("reduced-dictionary", "reduced-dictionary",
+          "Only match candidates against the chart marker IDs (923, 241, 1001-1007).",
+          DEFAULT_REDUCED_DICTIONARY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DETECT_SCALE,
+      g_param_spec_int ("detect-scale", "detect-scale",
+          "Detect markers on a 1/N downscaled image, then refine corners at full resolution (1 = full resolution).", 1, 8,
+          DEFAULT_DETECT_SCALE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DETECT_TILES,
+      g_param_spec_int ("detect-tiles", "detect-tiles",
+          "Detect markers on a NxN grid of overlapping tiles, in parallel (1 = whole image at once).", 1, 8,
+          DEFAULT_DETECT_TILES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_TRACK,
+      g_param_spec_boolean ("track", "track",
+          "Track the four corner markers, re-detecting them only around their predicted positions.",
+          DEFAULT_TRACK,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_TRACK_REACQUIRE_INTERVAL,
+      g_param_spec_int ("track-reacquire-interval", "track-reacquire-interval",
+          "Force a full frame detection every N frames while tracking (0 = only when markers are lost).", 0, G_MAXINT,
+          DEFAULT_TRACK_REACQUIRE_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_TRACK_PADDING,
+      g_param_spec_double ("track-padding", "track-padding",
+          "Padding around the predicted marker positions (relative to marker size).", 0.0, 10.0,
+          DEFAULT_TRACK_PADDING,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DETECT_INTERVAL,
+      g_param_spec_uint ("detect-interval", "detect-interval",
+          "Detect the chart at most every N frames, reusing its geometry in between while the markers do not move (1 = every frame).", 1, G_MAXUINT,
+          DEFAULT_DETECT_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_MOTION_THRESHOLD,
+      g_param_spec_double ("motion-threshold", "motion-threshold",
+          "Mean absolute luma difference over the corner markers above which the chart is re-detected (detect-interval > 1).", 0.0, 255.0,
+          DEFAULT_MOTION_THRESHOLD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_PRESENCE_FILTER,
+      g_param_spec_boolean ("presence-filter", "presence-filter",
+          "Skip marker detection when a quick quad search on a downscaled image finds no marker candidate.",
+          DEFAULT_PRESENCE_FILTER,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_PRESENCE_SCAN_INTERVAL,
+      g_param_spec_uint ("presence-scan-interval", "presence-scan-interval",
+          "Run a full detection at least every N frames, whatever the presence filter finds (0 = never forced).", 0, G_MAXUINT,
+          DEFAULT_PRESENCE_SCAN_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ASYNC,
+      g_param_spec_boolean ("async", "async",
+          "Analyze frames on a worker thread, overlaying the latest completed result (frames are never held back).",
+          DEFAULT_ASYNC,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_QUEUE_DEPTH,
+      g_param_spec_int ("queue-depth", "queue-depth",
+          "Maximum number of frames waiting for analysis (async), the oldest frame is dropped when full.", 1, 16,
+          DEFAULT_QUEUE_DEPTH,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_WORKER_CPU,
+      g_param_spec_int ("worker-cpu", "worker-cpu",
+          "CPU the analysis worker is pinned to (async, -1 = no affinity).", -1, 1023,
+          DEFAULT_WORKER_CPU,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_WORKER_POOL,
+      g_param_spec_enum ("worker-pool", "worker-pool",
+          "Where frames are analyzed in async mode (shared : one pool for all elements, fair across streams).",
+          GST_TYPE_MARKERDETECT_WORKER_POOL, DEFAULT_WORKER_POOL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_GROUP,
+      g_param_spec_string ("group", "group",
+          "Camera group (within the pipeline) : Color Checker measurements include the patch deltas to the group average.",
+          DEFAULT_GROUP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_DELTA_E,
+      g_param_spec_enum ("delta-e", "delta-e",
+          "Color difference used for the Color Checker Lab error.",
+          GST_TYPE_MARKERDETECT_DELTA_E, DEFAULT_DELTA_E,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_POST_MESSAGES,
+      g_param_spec_boolean ("post-messages", "post-messages",
+          "Post an element message (\"markerdetect\") on the bus for each chart measurement.",
+          DEFAULT_POST_MESSAGES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_SCRIPT_MODE,
+      g_param_spec_enum ("script-mode", "script-mode",
+          "How the Color Checker and White Balance scripts are run.",
+          GST_TYPE_MARKERDETECT_SCRIPT_MODE, DEFAULT_SCRIPT_MODE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_OVERLAY,
+      g_param_spec_enum ("overlay", "overlay",
+          "What is drawn on the frames (none keeps the buffers untouched, in passthrough).",
+          GST_TYPE_MARKERDETECT_OVERLAY, DEFAULT_OVERLAY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_OVERLAY_REFRESH_INTERVAL,
+      g_param_spec_uint ("overlay-refresh-interval", "overlay-refresh-interval",
+          "Update the Color Checker values shown on the overlay every N frames (the labels still follow the chart).",
+          1, G_MAXUINT, DEFAULT_OVERLAY_REFRESH_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "stats-interval",
+          "Time the processing stages, and post the stats every N frames (0 = disabled).",
+          0, G_MAXUINT, DEFAULT_STATS_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "stats",
+          "Per-stage p50/p95/p99/max times in ns, over the last frames (see stats-interval).",
+          GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_ATTACH_META,
+      g_param_spec_boolean ("attach-meta", "attach-meta",
+          "Attach the detection and chart results to each buffer as GstMarkerDetectMeta.",
+          DEFAULT_ATTACH_META,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  /**
+   * GstMarkerDetect::measured:
+   * @markerdetect: the element
+   * @measurement: the chart measurement (same structure as the element message)
+   *
+   * Emitted for each chart measurement (throttled by cc-skip-frames/wb-skip-frames),
+   * from the thread that analyzes the frames.
+   */
+  gst_markerdetect_signals[SIGNAL_MEASURED] =
+      g_signal_new ("measured", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+          0, NULL, NULL, NULL, G_TYPE_NONE, 1, GST_TYPE_STRUCTURE | G_SIGNAL_TYPE_STATIC_SCOPE);
             
   gobject_class->dispose = gst_markerdetect_dispose;
   gobject_class->finalize = gst_markerdetect_finalize;
   base_transform_class->start = GST_DEBUG_FUNCPTR (gst_markerdetect_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_markerdetect_stop);
+  base_transform_class->prepare_output_buffer = GST_DEBUG_FUNCPTR (gst_markerdetect_prepare_output_buffer);
+  base_transform_class->sink_event = GST_DEBUG_FUNCPTR (gst_markerdetect_sink_event);
+  GST_ELEMENT_CLASS(klass)->request_new_pad = GST_DEBUG_FUNCPTR (gst_markerdetect_request_new_pad);
+  GST_ELEMENT_CLASS(klass)->release_pad = GST_DEBUG_FUNCPTR (gst_markerdetect_release_pad);
   video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_markerdetect_set_info);
   video_filter_class->transform_frame_ip = GST_DEBUG_FUNCPTR (gst_markerdetect_transform_frame_ip);
 
@@ -184,909 +1185,3529 @@ gst_markerdetect_init (GstMarkerDetect *markerdetect)
    markerdetect->wb_extra_args = NULL;
    markerdetect->wb_skip_frames = 0;
    markerdetect->wb_frame_count = 0;
+
+   markerdetect->dictionary = DEFAULT_DICTIONARY;
+   markerdetect->adaptive_thresh_win_size_min = DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_MIN;
+   markerdetect->adaptive_thresh_win_size_max = DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_MAX;
+   markerdetect->adaptive_thresh_win_size_step = DEFAULT_ADAPTIVE_THRESH_WIN_SIZE_STEP;
+   markerdetect->min_marker_perimeter_rate = DEFAULT_MIN_MARKER_PERIMETER_RATE;
+   markerdetect->max_marker_perimeter_rate = DEFAULT_MAX_MARKER_PERIMETER_RATE;
+   markerdetect->corner_refinement_method = DEFAULT_CORNER_REFINEMENT_METHOD;
+   markerdetect->reduced_dictionary = DEFAULT_REDUCED_DICTIONARY;
+   markerdetect->detect_scale = DEFAULT_DETECT_SCALE;
+   markerdetect->detect_tiles = DEFAULT_DETECT_TILES;
+   markerdetect->track = DEFAULT_TRACK;
+   markerdetect->track_reacquire_interval = DEFAULT_TRACK_REACQUIRE_INTERVAL;
+   markerdetect->track_padding = DEFAULT_TRACK_PADDING;
+   markerdetect->detect_interval = DEFAULT_DETECT_INTERVAL;
+   markerdetect->motion_threshold = DEFAULT_MOTION_THRESHOLD;
+   markerdetect->presence_filter = DEFAULT_PRESENCE_FILTER;
+   markerdetect->presence_scan_interval = DEFAULT_PRESENCE_SCAN_INTERVAL;
+   markerdetect->async = DEFAULT_ASYNC;
+   markerdetect->queue_depth = DEFAULT_QUEUE_DEPTH;
+   markerdetect->worker_cpu = DEFAULT_WORKER_CPU;
+   markerdetect->worker_pool = DEFAULT_WORKER_POOL;
+   markerdetect->group = DEFAULT_GROUP;
+   markerdetect->delta_e = DEFAULT_DELTA_E;
+   markerdetect->post_messages = DEFAULT_POST_MESSAGES;
+   markerdetect->script_mode = DEFAULT_SCRIPT_MODE;
+   markerdetect->attach_meta = DEFAULT_ATTACH_META;
+   markerdetect->overlay = DEFAULT_OVERLAY;
+   markerdetect->overlay_refresh_interval = DEFAULT_OVERLAY_REFRESH_INTERVAL;
+   markerdetect->stats_interval = DEFAULT_STATS_INTERVAL;
+   markerdetect->stats = g_new0 (GstMarkerDetectStats, 1);
+   g_mutex_init (&markerdetect->stats->lock);
+   markerdetect->detector_dirty = TRUE;
+   markerdetect->context = NULL;
 }
 
-void
-gst_markerdetect_set_property (GObject * object, guint property_id,
-    const GValue * value, GParamSpec * pspec)
+/* (re)build the detector context from the current detector properties */
+static void
+gst_markerdetect_build_context (GstMarkerDetect *markerdetect)
 {
-  GstMarkerDetect *markerdetect = GST_MARKERDETECT (object);
+  GstMarkerDetectContext *context = markerdetect->context;
 
-  GST_DEBUG_OBJECT (markerdetect, "set_property");
+  GST_DEBUG_OBJECT (markerdetect, "build_context (dictionary=%d)", markerdetect->dictionary);
 
-  switch (property_id) {
-    case PROP_CC_SCRIPT:
-      g_free (markerdetect->cc_script);
-      markerdetect->cc_script = g_value_dup_string (value);
-      break;
-    case PROP_CC_EXTRA_ARGS:
-      g_free (markerdetect->cc_extra_args);
-      markerdetect->cc_extra_args = g_value_dup_string (value);
-      break;
-    case PROP_CC_SKIP_FRAMES:
-      markerdetect->cc_skip_frames = g_value_get_int (value);
-      break;
-    case PROP_CC_SHOW_GT:
-      markerdetect->cc_show_gt = g_value_get_boolean (value);
-      break;
-    case PROP_CC_SHOW_EC:
-      markerdetect->cc_show_ec = g_value_get_boolean (value);
-      break;
-    case PROP_WB_SCRIPT:
-      g_free (markerdetect->wb_script);
+#ifdef MARKERDETECT_HAVE_ARUCO_DETECTOR
+  cv::aruco::Dictionary dictionary = cv::aruco::getPredefinedDictionary(markerdetect->dictionary);
+  cv::aruco::Dictionary &d = dictionary;
+#else
+  cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(markerdetect->dictionary);
+  cv::aruco::Dictionary &d = *dictionary;
+#endif
+
+  // Reduced dictionary : only keep codewords of the chart markers,
+  // and remember which original ID each of them stands for
+  context->markerIdMap.clear();
+  if ( markerdetect->reduced_dictionary )
+  {
+    cv::Mat bytesList;
+    for ( unsigned i = 0; i < G_N_ELEMENTS(chartMarkerIds); i++ )
+    {
+      if ( chartMarkerIds[i] < d.bytesList.rows )
+      {
+        bytesList.push_back(d.bytesList.row(chartMarkerIds[i]));
+        context->markerIdMap.push_back(chartMarkerIds[i]);
+      }
+    }
+    if ( context->markerIdMap.size() > 0 )
+    {
+#ifdef MARKERDETECT_HAVE_ARUCO_DETECTOR
+      dictionary = cv::aruco::Dictionary(bytesList, d.markerSize, d.maxCorrectionBits);
+#else
+      dictionary = cv::makePtr<cv::aruco::Dictionary>(bytesList, d.markerSize, d.maxCorrectionBits);
+#endif
+    }
+    else
+    {
+      GST_WARNING_OBJECT (markerdetect, "dictionary contains none of the chart markers, using full dictionary");
+    }
+  }
+
+#ifdef MARKERDETECT_HAVE_ARUCO_DETECTOR
+  cv::aruco::DetectorParameters parameters;
+  cv::aruco::DetectorParameters *p = &parameters;
+#else
+  cv::Ptr<cv::aruco::DetectorParameters> parameters = cv::aruco::DetectorParameters::create();
+  cv::aruco::DetectorParameters *p = parameters.get();
+#endif
+  p->adaptiveThreshWinSizeMin = markerdetect->adaptive_thresh_win_size_min;
+  p->adaptiveThreshWinSizeMax = MAX(markerdetect->adaptive_thresh_win_size_max, markerdetect->adaptive_thresh_win_size_min);
+  p->adaptiveThreshWinSizeStep = markerdetect->adaptive_thresh_win_size_step;
+  p->minMarkerPerimeterRate = markerdetect->min_marker_perimeter_rate;
+  p->maxMarkerPerimeterRate = markerdetect->max_marker_perimeter_rate;
+  p->cornerRefinementMethod = static_cast<decltype(p->cornerRefinementMethod)>(markerdetect->corner_refinement_method);
+
+#ifdef MARKERDETECT_HAVE_ARUCO_DETECTOR
+  context->detector = cv::aruco::ArucoDetector(dictionary, parameters);
+#else
+  context->dictionary = dictionary;
+  context->parameters = parameters;
+#endif
+
+  // detector settings changed : re-detect the chart on the next frame
+  context->geometryValid = false;
+  markerdetect->detector_dirty = FALSE;
+}
+
+/* run the persistent detector context on an image (the detector is only read : tiles can run concurrently) */
+static void
+gst_markerdetect_detect (const GstMarkerDetectContext *context, cv::InputArray img,
+    std::vector<int> &markerIds, std::vector<std::vector<cv::Point2f>> &markerCorners,
+    std::vector<std::vector<cv::Point2f>> &rejectedCandidates)
+{
+  markerIds.clear();
+  markerCorners.clear();
+  rejectedCandidates.clear();
+#ifdef MARKERDETECT_HAVE_ARUCO_DETECTOR
+  context->detector.detectMarkers(img, markerCorners, markerIds, rejectedCandidates);
+#else
+  cv::aruco::detectMarkers(img, context->dictionary, markerCorners, markerIds, context->parameters, rejectedCandidates);
+#endif
+
+  // Translate reduced dictionary indices back to original marker IDs
+  if ( context->markerIdMap.size() > 0 )
+  {
+    for ( unsigned i = 0; i < markerIds.size(); i++ )
+    {
+      markerIds[i] = context->markerIdMap[markerIds[i]];
+    }
+  }
+}
+
+static void
+gst_markerdetect_run_detector (GstMarkerDetect *markerdetect, cv::InputArray img,
+    std::vector<int> &markerIds, std::vector<std::vector<cv::Point2f>> &markerCorners)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  gst_markerdetect_detect(context, img, markerIds, markerCorners, context->rejectedCandidates);
+}
+
+//
+// Tiled detection (detect-tiles)
+//
+// The image is split in a NxN grid of tiles, each grown by a margin of 1/4 of
+// the tile size on its inner sides, and the tiles are detected in parallel.
+// A marker smaller than the margin lies entirely inside at least one tile.
+// Markers found by several tiles (in the overlaps) are merged : the detection
+// farthest from the border of its tile is kept.
+//
+
+/* distance from a marker to the inner border of its tile (frame borders excluded) */
+static float
+gst_markerdetect_tile_border_distance (const std::vector<cv::Point2f> &corners, const cv::Rect &tile, const cv::Size &size)
+{
+  float d = FLT_MAX;
+  for ( unsigned k = 0; k < corners.size(); k++ )
+  {
+    if ( tile.x > 0 ) d = MIN(d, corners[k].x - tile.x);
+    if ( tile.y > 0 ) d = MIN(d, corners[k].y - tile.y);
+    if ( tile.x + tile.width < size.width ) d = MIN(d, tile.x + tile.width - 1 - corners[k].x);
+    if ( tile.y + tile.height < size.height ) d = MIN(d, tile.y + tile.height - 1 - corners[k].y);
+  }
+  return d;
+}
+
+static void
+gst_markerdetect_run_detector_tiled (GstMarkerDetect *markerdetect, const cv::Mat &img,
+    std::vector<int> &markerIds, std::vector<std::vector<cv::Point2f>> &markerCorners)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  int n = markerdetect->detect_tiles;
+
+  if ( n <= 1 )
+  {
+    gst_markerdetect_run_detector(markerdetect, img, markerIds, markerCorners);
+    return;
+  }
+
+  int tileW = (img.cols + n - 1) / n;
+  int tileH = (img.rows + n - 1) / n;
+  int marginX = tileW / 4;
+  int marginY = tileH / 4;
+  cv::Rect frameRect(0, 0, img.cols, img.rows);
+  std::vector<cv::Rect> &tiles = context->tiles;
+  tiles.clear();
+  for ( int ty = 0; ty < n; ty++ )
+  {
+    for ( int tx = 0; tx < n; tx++ )
+    {
+      cv::Rect tile(tx*tileW - marginX, ty*tileH - marginY, tileW + 2*marginX, tileH + 2*marginY);
+      tiles.push_back(tile & frameRect);
+    }
+  }
+
+  context->tileIds.resize(tiles.size());
+  context->tileCorners.resize(tiles.size());
+  context->tileRejected.resize(tiles.size());
+  cv::parallel_for_(cv::Range(0, tiles.size()), [&](const cv::Range &range) {
+    for ( int t = range.start; t < range.end; t++ )
+    {
+      gst_markerdetect_detect(context, img(tiles[t]), context->tileIds[t], context->tileCorners[t], context->tileRejected[t]);
+    }
+  });
+
+  // merge, back in image coordinates
+  std::vector<float> &borderDistance = context->tileBorderDistance;
+  borderDistance.clear();
+  markerIds.clear();
+  markerCorners.clear();
+  for ( unsigned t = 0; t < tiles.size(); t++ )
+  {
+    for ( unsigned i = 0; i < context->tileIds[t].size(); i++ )
+    {
+      std::vector<cv::Point2f> &corners = context->tileCorners[t][i];
+      cv::Point2f center(0, 0);
+      for ( unsigned k = 0; k < corners.size(); k++ )
+      {
+        corners[k] += cv::Point2f(tiles[t].x, tiles[t].y);
+        center += corners[k] * 0.25f;
+      }
+      float distance = gst_markerdetect_tile_border_distance(corners, tiles[t], img.size());
+
+      // same marker already found by another tile : its center lies inside this one
+      unsigned j;
+      for ( j = 0; j < markerIds.size(); j++ )
+      {
+        if ( markerIds[j] == context->tileIds[t][i] && cv::pointPolygonTest(markerCorners[j], center, false) >= 0 )
+          break;
+      }
+      if ( j == markerIds.size() )
+      {
+        markerIds.push_back(context->tileIds[t][i]);
+        markerCorners.push_back(corners);
+        borderDistance.push_back(distance);
+      }
+      else if ( distance > borderDistance[j] )
+      {
+        markerCorners[j] = corners;
+        borderDistance[j] = distance;
+      }
+    }
+  }
+}
+
+/* role of a marker in the charts : 0=top left, 1=top right, 2=bottom left, 3=bottom right, -1=none */
+static int
+gst_markerdetect_marker_role (int id)
+{
+  switch ( id )
+  {
+  case 923:
+    return 0;
+  case 1001:
+  case 1002:
+  case 1003:
+  case 1004:
+  case 1005:
+  case 1006:
+    return 1;
+  case 1007:
+    return 2;
+  case 241:
+    return 3;
+  default:
+    return -1;
+  }
+}
+
+/* wrap the mapped video frame planes */
+static void
+gst_markerdetect_map_image (GstMarkerDetect *markerdetect, GstVideoFrame *frame, GstMarkerDetectImage *img)
+{
+  img->format = GST_VIDEO_FRAME_FORMAT(frame);
+  img->width = GST_VIDEO_FRAME_WIDTH(frame);
+  img->height = GST_VIDEO_FRAME_HEIGHT(frame);
+
+  switch ( img->format )
+  {
+  case GST_VIDEO_FORMAT_NV12:
+    img->luma = cv::Mat(img->height, img->width, CV_8UC1,
+      GST_VIDEO_FRAME_PLANE_DATA(frame, 0), GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0));
+    img->chroma = cv::Mat((img->height+1)/2, (img->width+1)/2, CV_8UC2,
+      GST_VIDEO_FRAME_PLANE_DATA(frame, 1), GST_VIDEO_FRAME_PLANE_STRIDE(frame, 1));
+    break;
+  case GST_VIDEO_FORMAT_YUY2:
+    img->chroma = cv::Mat(img->height, (img->width+1)/2, CV_8UC4,
+      GST_VIDEO_FRAME_PLANE_DATA(frame, 0), GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0));
+    break;
+  case GST_VIDEO_FORMAT_GRAY8:
+    img->luma = cv::Mat(img->height, img->width, CV_8UC1,
+      GST_VIDEO_FRAME_PLANE_DATA(frame, 0), GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0));
+    break;
+  case GST_VIDEO_FORMAT_BGR:
+  default:
+    img->bgr = cv::Mat(img->height, img->width, CV_8UC3,
+      GST_VIDEO_FRAME_PLANE_DATA(frame, 0), GST_VIDEO_FRAME_PLANE_STRIDE(frame, 0));
+    break;
+  }
+}
+
+/* refine marker corners at full resolution (after detection on a decimated image) */
+static void
+gst_markerdetect_refine_corners (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, int halfWin)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  cv::Rect frameRect(0, 0, img->width, img->height);
+  cv::TermCriteria criteria(cv::TermCriteria::COUNT | cv::TermCriteria::EPS, 30, 0.01);
+  int size = 2*halfWin + 5;
+
+  for ( unsigned i = 0; i < context->markerCorners.size(); i++ )
+  {
+    for ( unsigned j = 0; j < context->markerCorners[i].size(); j++ )
+    {
+      cv::Point2f &corner = context->markerCorners[i][j];
+      // only look at a small window around the (upscaled) corner
+      cv::Rect roi(cvRound(corner.x) - size/2, cvRound(corner.y) - size/2, size, size);
+      roi &= frameRect;
+      if ( roi.width < size || roi.height < size )
+        continue;
+      cv::Mat gray;
+      if ( img->format == GST_VIDEO_FORMAT_BGR )
+      {
+        cv::cvtColor(img->bgr(roi), context->refineImage, cv::COLOR_BGR2GRAY);
+        gray = context->refineImage;
+      }
+      else
+      {
+        gray = img->luma(roi);
+      }
+      cv::Point2f pt = corner - cv::Point2f(roi.x, roi.y);
+      cv::Mat ptMat(1, 1, CV_32FC2, &pt);
+      cv::cornerSubPix(gray, ptMat, cv::Size(halfWin, halfWin), cv::Size(-1, -1), criteria);
+      corner = pt + cv::Point2f(roi.x, roi.y);
+    }
+  }
+}
+
+/* remember the four corner markers (and their motion) for the next frame */
+static void
+gst_markerdetect_update_track (GstMarkerDetect *markerdetect, bool acquired)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  int found[4] = { -1, -1, -1, -1 };
+
+  for ( unsigned i = 0; i < context->markerIds.size(); i++ )
+  {
+    int role = gst_markerdetect_marker_role(context->markerIds[i]);
+    if ( role >= 0 && found[role] < 0 )
+      found[role] = i;
+  }
+  if ( found[0] < 0 || found[1] < 0 || found[2] < 0 || found[3] < 0 )
+  {
+    context->trackValid = false;
+    return;
+  }
+
+  for ( int r = 0; r < 4; r++ )
+  {
+    const std::vector<cv::Point2f> &corners = context->markerCorners[found[r]];
+    cv::Point2f center = (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25;
+    if ( context->trackValid && !acquired && context->trackIds[r] == context->markerIds[found[r]] )
+      context->trackVelocity[r] = center - context->trackCenter[r];
+    else
+      context->trackVelocity[r] = cv::Point2f(0, 0);
+    context->trackIds[r] = context->markerIds[found[r]];
+    context->trackCenter[r] = center;
+    for ( int k = 0; k < 4; k++ )
+      context->trackCorners[r][k] = corners[k];
+  }
+  context->trackValid = true;
+  if ( acquired )
+    context->trackFrames = 0;
+}
+
+/* re-detect the tracked markers inside padded ROIs around their predicted positions */
+static bool
+gst_markerdetect_track_markers (GstMarkerDetect *markerdetect, const cv::Mat &src)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  cv::Rect frameRect(0, 0, src.cols, src.rows);
+
+  context->markerIds.clear();
+  context->markerCorners.clear();
+  for ( int r = 0; r < 4; r++ )
+  {
+    // predicted corners (constant velocity), and their padded bounding box
+    cv::Point2f p = context->trackCorners[r][0] + context->trackVelocity[r];
+    float xmin = p.x, ymin = p.y, xmax = p.x, ymax = p.y;
+    for ( int k = 1; k < 4; k++ )
+    {
+      p = context->trackCorners[r][k] + context->trackVelocity[r];
+      xmin = MIN(xmin, p.x); ymin = MIN(ymin, p.y);
+      xmax = MAX(xmax, p.x); ymax = MAX(ymax, p.y);
+    }
+    float pad = MAX(xmax - xmin, ymax - ymin) * markerdetect->track_padding + 4;
+    cv::Rect roi(cvFloor(xmin - pad), cvFloor(ymin - pad), cvCeil(xmax - xmin + 2*pad), cvCeil(ymax - ymin + 2*pad));
+    roi &= frameRect;
+    if ( roi.width < 8 || roi.height < 8 )
+      return false;
+
+    gst_markerdetect_run_detector(markerdetect, src(roi), context->roiIds, context->roiCorners);
+
+    // keep the tracked marker only (a ROI may also contain parts of its neighbours)
+    unsigned i;
+    for ( i = 0; i < context->roiIds.size(); i++ )
+    {
+      if ( context->roiIds[i] == context->trackIds[r] )
+        break;
+    }
+    if ( i == context->roiIds.size() )
+      return false;
+    for ( int k = 0; k < 4; k++ )
+      context->roiCorners[i][k] += cv::Point2f(roi.x, roi.y);
+    context->markerIds.push_back(context->roiIds[i]);
+    context->markerCorners.push_back(context->roiCorners[i]);
+  }
+  return true;
+}
+
+/* presence filter : can a marker be in the frame ? (any convex dark quad, large enough,
+   on a downscaled image binarized with a single adaptive threshold window) */
+static bool
+gst_markerdetect_markers_present (GstMarkerDetect *markerdetect, const cv::Mat &src)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  int side = MAX(src.cols, src.rows);
+
+  // Always work on a small image (largest side GST_MARKERDETECT_PRESENCE_SIZE) : the
+  // smallest markers shrink to a few pixels, but still show up as small dark quads
+  double f = MIN(1.0, (double)GST_MARKERDETECT_PRESENCE_SIZE / side);
+  cv::Size size(MAX(cvRound(src.cols*f), 1), MAX(cvRound(src.rows*f), 1));
+  if ( src.channels() == 3 )
+  {
+    cv::resize(src, context->presenceImage, size, 0, 0, cv::INTER_AREA);
+    cv::cvtColor(context->presenceImage, context->presenceGray, cv::COLOR_BGR2GRAY);
+  }
+  else
+  {
+    cv::resize(src, context->presenceGray, size, 0, 0, cv::INTER_AREA);
+  }
+
+  // Markers are dark squares (black border) on a white quiet zone : the threshold
+  // window follows the smallest marker side, in working image pixels
+  double minSide = markerdetect->min_marker_perimeter_rate * MAX(size.width, size.height) / 4;
+  int win = 2 * MAX(GST_MARKERDETECT_PRESENCE_MIN_WINDOW, cvRound(minSide)) + 1;
+  cv::adaptiveThreshold(context->presenceGray, context->presenceBinary, 255,
+    cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV, win, 7);
+  cv::findContours(context->presenceBinary, context->presenceContours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+
+  // Contours run through the border pixel centers and small markers are blurred by the
+  // downscale, so the smallest markers are accepted down to half their nominal perimeter
+  // (a false candidate only costs a full detection)
+  double minPerimeter = 2 * minSide;
+  double maxPerimeter = markerdetect->max_marker_perimeter_rate * MAX(size.width, size.height);
+  for ( unsigned i = 0; i < context->presenceContours.size(); i++ )
+  {
+    const std::vector<cv::Point> &contour = context->presenceContours[i];
+    if ( contour.size() < 4 )
+      continue;
+    double perimeter = cv::arcLength(contour, true);
+    if ( perimeter < minPerimeter || perimeter > maxPerimeter )
+      continue;
+    cv::approxPolyDP(contour, context->presenceQuad, 0.05 * perimeter, true);
+    if ( context->presenceQuad.size() == 4 && cv::isContourConvex(context->presenceQuad) )
+      return true;
+  }
+  return false;
+}
+
+/* detect markers (optionally coarse-to-fine, on a decimated image) */
+static void
+gst_markerdetect_detect_markers (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  if ( img->format == GST_VIDEO_FORMAT_YUY2 )
+  {
+    // Y is interleaved with U/V, so detection needs a (single) copy of the luma
+    context->yuy2Luma.create(img->height, img->width, CV_8UC1);
+    cv::extractChannel(cv::Mat(img->height, img->width, CV_8UC2, img->chroma.data, img->chroma.step), context->yuy2Luma, 0);
+    img->luma = context->yuy2Luma;
+  }
+  // Detection only needs luma, so native YUV/GRAY formats are detected on their Y plane
+  const cv::Mat &src = (img->format == GST_VIDEO_FORMAT_BGR) ? img->bgr : img->luma;
+  int scale = markerdetect->detect_scale;
+
+  // Tracking : only look around the predicted marker positions,
+  // until markers are lost or the re-acquisition interval expires
+  if ( markerdetect->track && context->trackValid &&
+       ( (markerdetect->track_reacquire_interval == 0) ||
+         (context->trackFrames < (unsigned)markerdetect->track_reacquire_interval) ) )
+  {
+    if ( gst_markerdetect_track_markers(markerdetect, src) )
+    {
+      context->trackFrames++;
+      gst_markerdetect_update_track(markerdetect, false);
+      return;
+    }
+    GST_LOG_OBJECT (markerdetect, "tracked markers lost, re-acquiring on full frame");
+  }
+
+  // Presence filter : skip the full detection on frames without any marker candidate,
+  // but still scan the full frame every presence-scan-interval frames
+  if ( markerdetect->presence_filter )
+  {
+    unsigned interval = markerdetect->presence_scan_interval;
+    if ( (interval == 0 || context->presenceSkipped + 1 < interval) &&
+         !gst_markerdetect_markers_present(markerdetect, src) )
+    {
+      context->presenceSkipped++;
+      context->markerIds.clear();
+      context->markerCorners.clear();
+      context->trackValid = false;
+      return;
+    }
+    context->presenceSkipped = 0;
+  }
+
+  if ( scale <= 1 )
+  {
+    gst_markerdetect_run_detector_tiled(markerdetect, src, context->markerIds, context->markerCorners);
+    gst_markerdetect_update_track(markerdetect, true);
+    return;
+  }
+
+  // Coarse : find candidates on the decimated image
+  cv::Size size(MAX(src.cols/scale, 1), MAX(src.rows/scale, 1));
+  cv::resize(src, context->detectImage, size, 0, 0, cv::INTER_AREA);
+  gst_markerdetect_run_detector_tiled(markerdetect, context->detectImage, context->markerIds, context->markerCorners);
+
+  // Fine : scale corners back up (pixel centers), and refine them on the full resolution frame
+  float sx = (float)src.cols / size.width;
+  float sy = (float)src.rows / size.height;
+  for ( unsigned i = 0; i < context->markerCorners.size(); i++ )
+  {
+    for ( unsigned j = 0; j < context->markerCorners[i].size(); j++ )
+    {
+      cv::Point2f &corner = context->markerCorners[i][j];
+      corner.x = (corner.x + 0.5f) * sx - 0.5f;
+      corner.y = (corner.y + 0.5f) * sy - 0.5f;
+    }
+  }
+  gst_markerdetect_refine_corners(markerdetect, img, 2*scale + 1);
+  gst_markerdetect_update_track(markerdetect, true);
+}
+
+/* set up BGR <=> YUV conversion for the negotiated colorimetry */
+static void
+gst_markerdetect_set_colorimetry (GstMarkerDetect *markerdetect, GstVideoInfo *info)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  gint offset[GST_VIDEO_MAX_COMPONENTS];
+  gint scale[GST_VIDEO_MAX_COMPONENTS];
+  gdouble Kr, Kb;
+
+  if ( !gst_video_color_matrix_get_Kr_Kb(info->colorimetry.matrix, &Kr, &Kb) )
+  {
+    // default to BT.601
+    Kr = 0.299;
+    Kb = 0.114;
+  }
+  gst_video_color_range_offsets(info->colorimetry.range, info->finfo, offset, scale);
+
+  context->Kr = Kr;
+  context->Kb = Kb;
+  for ( int c = 0; c < 3; c++ )
+  {
+    context->yuvOffset[c] = offset[c];
+    context->yuvScale[c] = scale[c] / 255.0;
+  }
+  if ( GST_VIDEO_INFO_FORMAT(info) == GST_VIDEO_FORMAT_GRAY8 )
+  {
+    // full range luma only (neutral chroma)
+    for ( int c = 0; c < 3; c++ )
+    {
+      context->yuvOffset[c] = (c == 0) ? 0 : 128;
+      context->yuvScale[c] = 1.0;
+    }
+  }
+}
+
+/* convert a BGR color (0-255) to the YUV values of the native format */
+static cv::Vec3b
+gst_markerdetect_bgr_to_yuv (const GstMarkerDetectContext *context, double b, double g, double r)
+{
+  double Kr = context->Kr;
+  double Kb = context->Kb;
+  double y = Kr*r + (1.0-Kr-Kb)*g + Kb*b;
+  double u = (b - y) / (2.0*(1.0-Kb));
+  double v = (r - y) / (2.0*(1.0-Kr));
+  return cv::Vec3b(
+    cv::saturate_cast<uchar>(context->yuvOffset[0] + context->yuvScale[0]*y),
+    cv::saturate_cast<uchar>(context->yuvOffset[1] + context->yuvScale[1]*u),
+    cv::saturate_cast<uchar>(context->yuvOffset[2] + context->yuvScale[2]*v) );
+}
+
+/* convert YUV values of the native format to a BGR color (0-255) */
+static cv::Scalar
+gst_markerdetect_yuv_to_bgr (const GstMarkerDetectContext *context, double y, double u, double v)
+{
+  double Kr = context->Kr;
+  double Kb = context->Kb;
+  y = (y - context->yuvOffset[0]) / context->yuvScale[0];
+  u = (u - context->yuvOffset[1]) / context->yuvScale[1];
+  v = (v - context->yuvOffset[2]) / context->yuvScale[2];
+  double r = y + 2.0*(1.0-Kr)*v;
+  double b = y + 2.0*(1.0-Kb)*u;
+  double g = (y - Kr*r - Kb*b) / (1.0-Kr-Kb);
+  return cv::Scalar(MIN(MAX(b,0.0),255.0), MIN(MAX(g,0.0),255.0), MIN(MAX(r,0.0),255.0));
+}
+
+//
+// Homographies
+//
+// The chart geometry only ever maps 4 points onto 4 points, so the homography is
+// solved (and points are projected) on the stack, without cv::Mat temporaries.
+//
+
+/* homography mapping src[4] onto dst[4] (same system as cv::getPerspectiveTransform) */
+static cv::Matx33d
+gst_markerdetect_homography (const cv::Point2f src[4], const cv::Point2f dst[4])
+{
+  cv::Matx<double, 8, 8> A;
+  cv::Vec<double, 8> b;
+  for ( int i = 0; i < 4; i++ )
+  {
+    A(i,0) = A(i+4,3) = src[i].x;
+    A(i,1) = A(i+4,4) = src[i].y;
+    A(i,2) = A(i+4,5) = 1.0;
+    A(i,3) = A(i,4) = A(i,5) = 0.0;
+    A(i+4,0) = A(i+4,1) = A(i+4,2) = 0.0;
+    A(i,6) = -src[i].x*dst[i].x;
+    A(i,7) = -src[i].y*dst[i].x;
+    A(i+4,6) = -src[i].x*dst[i].y;
+    A(i+4,7) = -src[i].y*dst[i].y;
+    b[i] = dst[i].x;
+    b[i+4] = dst[i].y;
+  }
+  cv::Vec<double, 8> h = A.solve(b, cv::DECOMP_LU);
+  return cv::Matx33d(h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], 1.0);
+}
+
+/* project (x,y) through a homography */
+static inline cv::Point2f
+gst_markerdetect_project (const cv::Matx33d &H, float x, float y)
+{
+  double w = H(2,0)*x + H(2,1)*y + H(2,2);
+  return cv::Point2f((float)((H(0,0)*x + H(0,1)*y + H(0,2)) / w),
+                     (float)((H(1,0)*x + H(1,1)*y + H(1,2)) / w));
+}
+
+//
+// Polygon sampling (gstmarkerdetectsampling.cpp, on the native planes)
+//
+
+/* sampling planes of a frame */
+static GstMarkerDetectLayout
+gst_markerdetect_sample_planes (const GstMarkerDetectImage *img, GstMarkerDetectPlane planes[2])
+{
+  const cv::Mat *mats[2] = { &img->bgr, NULL };
+  GstMarkerDetectLayout layout = GST_MARKERDETECT_LAYOUT_BGR;
+
+  switch ( img->format )
+  {
+  case GST_VIDEO_FORMAT_NV12:
+    layout = GST_MARKERDETECT_LAYOUT_NV12;
+    mats[0] = &img->luma;
+    mats[1] = &img->chroma;
+    break;
+  case GST_VIDEO_FORMAT_YUY2:
+    layout = GST_MARKERDETECT_LAYOUT_YUY2;
+    mats[0] = &img->chroma;
+    break;
+  case GST_VIDEO_FORMAT_GRAY8:
+    layout = GST_MARKERDETECT_LAYOUT_GRAY8;
+    mats[0] = &img->luma;
+    break;
+  default:
+    break;
+  }
+  for ( int i = 0; i < 2; i++ )
+  {
+    const cv::Mat *mat = (mats[i] != NULL) ? mats[i] : mats[0];
+    planes[i].data = mat->ptr<uint8_t>(0);
+    planes[i].stride = (int) mat->step[0];
+    planes[i].cols = mat->cols;
+    planes[i].rows = mat->rows;
+    planes[i].channels = mat->channels();
+  }
+  return layout;
+}
+
+/* mean BGR color inside a quad, computed on the native planes */
+static cv::Scalar
+gst_markerdetect_quad_mean (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, const cv::Point quad[4])
+{
+  GstMarkerDetectPlane planes[2];
+  GstMarkerDetectPoint q[4];
+  double means[3];
+
+  GstMarkerDetectLayout layout = gst_markerdetect_sample_planes(img, planes);
+  for ( int i = 0; i < 4; i++ )
+  {
+    q[i].x = quad[i].x;
+    q[i].y = quad[i].y;
+  }
+  gst_markerdetect_sample_mean(layout, planes, q, means, NULL);
+  if ( (layout == GST_MARKERDETECT_LAYOUT_BGR) || (layout == GST_MARKERDETECT_LAYOUT_GRAY8) )
+    return cv::Scalar(means[0], means[1], means[2]);
+  return gst_markerdetect_yuv_to_bgr(markerdetect->context, means[0], means[1], means[2]);
+}
+
+/* 256-bin histograms inside a quad, computed on the native planes
+   (BGR : B,G,R, NV12/YUY2 : Y,U,V, GRAY8 : Y) ; returns number of histograms */
+static int
+gst_markerdetect_quad_histograms (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, const cv::Point quad[4], float hist[3][256])
+{
+  GstMarkerDetectPlane planes[2];
+  GstMarkerDetectPoint q[4];
+
+  GstMarkerDetectLayout layout = gst_markerdetect_sample_planes(img, planes);
+  for ( int i = 0; i < 4; i++ )
+  {
+    q[i].x = quad[i].x;
+    q[i].y = quad[i].y;
+  }
+  return gst_markerdetect_sample_histograms(layout, planes, q, hist);
+}
+
+/* per patch distances (over the components from 'first' on), and per component absolute error sums */
+static void
+gst_markerdetect_color_errors (const cv::Mat3f &mean, const cv::Mat3f &ref, int first,
+    float *patchErrors, float chartError[4])
+{
+  chartError[0] = chartError[1] = chartError[2] = chartError[3] = 0.0;
+  for ( int i = 0; i < mean.rows; i++ )
+  {
+    cv::Vec3f d = ref(i,0) - mean(i,0);
+    float e = 0.0;
+    for ( int c = first; c < 3; c++ )
+      e += d[c]*d[c];
+    e = std::sqrt(e);
+    if ( patchErrors != NULL )
+      patchErrors[i] = e;
+    chartError[0] += e;
+    for ( int c = 0; c < 3; c++ )
+      chartError[1+c] += std::fabs(d[c]);
+  }
+}
+
+/* CIEDE2000 color difference between two Lab colors
+   ref : G. Sharma, W. Wu, E. Dalal, "The CIEDE2000 Color-Difference Formula" (2005) */
+static float
+gst_markerdetect_ciede2000 (const cv::Vec3f &lab1, const cv::Vec3f &lab2)
+{
+  const double pi = CV_PI;
+  const double pow25_7 = 6103515625.0; // 25^7
+  double L1 = lab1[0], a1 = lab1[1], b1 = lab1[2];
+  double L2 = lab2[0], a2 = lab2[1], b2 = lab2[2];
+
+  double Cm = (std::sqrt(a1*a1 + b1*b1) + std::sqrt(a2*a2 + b2*b2)) / 2;
+  double Cm7 = std::pow(Cm, 7);
+  double G = 0.5 * (1 - std::sqrt(Cm7 / (Cm7 + pow25_7)));
+  double a1p = (1 + G) * a1;
+  double a2p = (1 + G) * a2;
+  double C1p = std::sqrt(a1p*a1p + b1*b1);
+  double C2p = std::sqrt(a2p*a2p + b2*b2);
+  double h1p = (C1p == 0) ? 0 : std::atan2(b1, a1p);
+  double h2p = (C2p == 0) ? 0 : std::atan2(b2, a2p);
+  if ( h1p < 0 ) h1p += 2*pi;
+  if ( h2p < 0 ) h2p += 2*pi;
+
+  double dLp = L2 - L1;
+  double dCp = C2p - C1p;
+  double dhp = 0;
+  if ( C1p*C2p != 0 )
+  {
+    dhp = h2p - h1p;
+    if ( dhp > pi ) dhp -= 2*pi;
+    else if ( dhp < -pi ) dhp += 2*pi;
+  }
+  double dHp = 2 * std::sqrt(C1p*C2p) * std::sin(dhp/2);
+
+  double Lpm = (L1 + L2) / 2;
+  double Cpm = (C1p + C2p) / 2;
+  double hpm = h1p + h2p;
+  if ( C1p*C2p != 0 )
+  {
+    if ( std::fabs(h1p - h2p) > pi )
+      hpm += (hpm < 2*pi) ? 2*pi : -2*pi;
+    hpm /= 2;
+  }
+  double T = 1 - 0.17*std::cos(hpm - pi/6) + 0.24*std::cos(2*hpm)
+               + 0.32*std::cos(3*hpm + pi/30) - 0.20*std::cos(4*hpm - 63*pi/180);
+  double dTheta = (pi/6) * std::exp(-std::pow((hpm*180/pi - 275) / 25, 2));
+  double Cpm7 = std::pow(Cpm, 7);
+  double Rc = 2 * std::sqrt(Cpm7 / (Cpm7 + pow25_7));
+  double Sl = 1 + 0.015*(Lpm - 50)*(Lpm - 50) / std::sqrt(20 + (Lpm - 50)*(Lpm - 50));
+  double Sc = 1 + 0.045*Cpm;
+  double Sh = 1 + 0.015*Cpm*T;
+  double Rt = -std::sin(2*dTheta) * Rc;
+
+  return std::sqrt( (dLp/Sl)*(dLp/Sl) + (dCp/Sc)*(dCp/Sc) + (dHp/Sh)*(dHp/Sh) + Rt*(dCp/Sc)*(dHp/Sh) );
+}
+
+/* convert the Color Checker ground truth to every color space (once, when the context is created) */
+static void
+gst_markerdetect_init_references (GstMarkerDetectContext *context)
+{
+  context->refBGR.create(24, 1);
+  for ( int i = 0; i < 24; i++ )
+  {
+    context->refBGR(i,0) = cv::Vec3f(chartColorsRef[i][0], chartColorsRef[i][1], chartColorsRef[i][2]);
+  }
+  cv::cvtColor(context->refBGR, context->refYUV, cv::COLOR_BGR2YUV);
+  // float Lab conversion expects BGR in 0-1
+  context->refBGR.convertTo(context->patchScaled, CV_32F, 1.0/255);
+  cv::cvtColor(context->patchScaled, context->refLab, cv::COLOR_BGR2Lab);
+  cv::cvtColor(context->refBGR, context->refHSV, cv::COLOR_BGR2HSV);
+  cv::cvtColor(context->refBGR, context->refXYZ, cv::COLOR_BGR2XYZ);
+  context->patchBGR.create(24, 1);
+}
+
+/* Color Checker errors in each color space, with one conversion of the 24 measured colors per space */
+static void
+gst_markerdetect_chart_errors (GstMarkerDetect *markerdetect, GstMarkerDetectResult *result)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  cv::cvtColor(context->patchBGR, context->patchYUV, cv::COLOR_BGR2YUV);
+  context->patchBGR.convertTo(context->patchScaled, CV_32F, 1.0/255);
+  cv::cvtColor(context->patchScaled, context->patchLab, cv::COLOR_BGR2Lab);
+  cv::cvtColor(context->patchBGR, context->patchHSV, cv::COLOR_BGR2HSV);
+  cv::cvtColor(context->patchBGR, context->patchXYZ, cv::COLOR_BGR2XYZ);
+
+  gst_markerdetect_color_errors(context->patchBGR, context->refBGR, 0, NULL, result->chartErrors[0]);
+  // YUV patch error only looks at chroma (U,V)
+  gst_markerdetect_color_errors(context->patchYUV, context->refYUV, 1, result->patchErrorYUV, result->chartErrors[1]);
+  gst_markerdetect_color_errors(context->patchLab, context->refLab, 0, NULL, result->chartErrors[2]);
+  gst_markerdetect_color_errors(context->patchHSV, context->refHSV, 0, NULL, result->chartErrors[3]);
+  gst_markerdetect_color_errors(context->patchXYZ, context->refXYZ, 0, NULL, result->chartErrors[4]);
+
+  if ( markerdetect->delta_e == GST_MARKERDETECT_DELTA_E_CIEDE2000 )
+  {
+    result->chartErrors[2][0] = 0.0;
+    for ( int i = 0; i < 24; i++ )
+    {
+      result->chartErrors[2][0] += gst_markerdetect_ciede2000(context->refLab(i,0), context->patchLab(i,0));
+    }
+  }
+}
+
+//
+// Overlay drawing
+//
+// BGR frames are drawn on directly. For the YUV/GRAY formats, each primitive is
+// drawn as coverage into a mask (sized to the primitive's bounding box), which
+// is then blended into the native planes with the color converted to YUV.
+// Chroma samples take the maximum coverage of the luma pixels they cover.
+// Warped images (plots) go through the same bounded mask for every format, so
+// compositing them costs the chart's screen area rather than full frames.
+//
+
+/* blend a coverage mask into the native planes, with a fixed color or a BGR image */
+static void
+gst_markerdetect_blend_mask (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img,
+    const cv::Rect &roi, const cv::Mat1b &mask, const cv::Scalar &color, const cv::Mat *overlay)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  #define BLEND(dst,src,a) (dst) = (uchar)((dst) + ((((int)(src) - (int)(dst)) * (a) + 127) / 255))
+
+  if ( img->format == GST_VIDEO_FORMAT_BGR )
+  {
+    for ( int y = 0; y < roi.height; y++ )
+    {
+      const uchar *m = mask.ptr<uchar>(y);
+      const uchar *o = overlay ? overlay->ptr<uchar>(y) : NULL;
+      uchar *dst = img->bgr.ptr<uchar>(roi.y+y) + roi.x*3;
+      for ( int x = 0; x < roi.width; x++ )
+      {
+        int a = m[x];
+        if ( a == 0 ) continue;
+        for ( int c = 0; c < 3; c++ )
+          BLEND(dst[x*3+c], o ? o[x*3+c] : color[c], a);
+      }
+    }
+    return;
+  }
+
+  cv::Vec3b yuv = gst_markerdetect_bgr_to_yuv(context, color[0], color[1], color[2]);
+
+  // Luma
+  for ( int y = 0; y < roi.height; y++ )
+  {
+    const uchar *m = mask.ptr<uchar>(y);
+    const cv::Vec3b *o = overlay ? overlay->ptr<cv::Vec3b>(y) : NULL;
+    uchar *dst = (img->format == GST_VIDEO_FORMAT_YUY2) ?
+      img->chroma.ptr<uchar>(roi.y+y) + roi.x*2 : img->luma.ptr<uchar>(roi.y+y) + roi.x;
+    int step = (img->format == GST_VIDEO_FORMAT_YUY2) ? 2 : 1;
+    for ( int x = 0; x < roi.width; x++, dst += step )
+    {
+      int a = m[x];
+      if ( a == 0 ) continue;
+      uchar Y = o ? gst_markerdetect_bgr_to_yuv(context, o[x][0], o[x][1], o[x][2])[0] : yuv[0];
+      BLEND(*dst, Y, a);
+    }
+  }
+
+  // Chroma (2x2 blocks for NV12, 2x1 pairs for YUY2)
+  if ( img->format == GST_VIDEO_FORMAT_NV12 || img->format == GST_VIDEO_FORMAT_YUY2 )
+  {
+    int sub_y = (img->format == GST_VIDEO_FORMAT_NV12) ? 2 : 1;
+    int cx0 = roi.x / 2, cx1 = (roi.x + roi.width - 1) / 2;
+    int cy0 = roi.y / sub_y, cy1 = (roi.y + roi.height - 1) / sub_y;
+    for ( int cy = cy0; cy <= cy1; cy++ )
+    {
+      uchar *dst = img->chroma.ptr<uchar>(cy);
+      for ( int cx = cx0; cx <= cx1; cx++ )
+      {
+        // coverage (and overlay pixel) with maximum coverage within the block
+        int a = 0, ax = 0, ay = 0;
+        for ( int dy = 0; dy < sub_y; dy++ )
+        {
+          int my = cy*sub_y + dy - roi.y;
+          if ( my < 0 || my >= roi.height ) continue;
+          for ( int dx = 0; dx < 2; dx++ )
+          {
+            int mx = cx*2 + dx - roi.x;
+            if ( mx < 0 || mx >= roi.width ) continue;
+            if ( mask(my, mx) > a ) { a = mask(my, mx); ax = mx; ay = my; }
+          }
+        }
+        if ( a == 0 ) continue;
+        cv::Vec3b c = yuv;
+        if ( overlay )
+        {
+          const cv::Vec3b &o = overlay->ptr<cv::Vec3b>(ay)[ax];
+          c = gst_markerdetect_bgr_to_yuv(context, o[0], o[1], o[2]);
+        }
+        if ( img->format == GST_VIDEO_FORMAT_NV12 )
+        {
+          BLEND(dst[cx*2+0], c[1], a);
+          BLEND(dst[cx*2+1], c[2], a);
+        }
+        else
+        {
+          BLEND(dst[cx*4+1], c[1], a);
+          BLEND(dst[cx*4+3], c[2], a);
+        }
+      }
+    }
+  }
+
+  #undef BLEND
+}
+
+/* format an overlay label into the context's string (no allocation once its capacity is reserved) */
+static const std::string &
+gst_markerdetect_label (GstMarkerDetect *markerdetect, const char *format, ...)
+{
+  std::string &label = markerdetect->context->label;
+  char text[GST_MARKERDETECT_LABEL_SIZE];
+  va_list args;
+
+  va_start (args, format);
+  int length = vsnprintf (text, sizeof(text), format, args);
+  va_end (args);
+  label.assign(text, CLAMP(length, 0, (int)sizeof(text) - 1));
+  return label;
+}
+
+/* clip a primitive's bounding box to the frame, and get a cleared drawing mask for it */
+static bool
+gst_markerdetect_draw_mask (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, cv::Rect &roi, cv::Mat1b &mask)
+{
+  roi &= cv::Rect(0, 0, img->width, img->height);
+  if ( roi.empty() )
+    return false;
+  mask = markerdetect->context->drawMask(cv::Rect(0, 0, roi.width, roi.height));
+  mask.setTo(cv::Scalar(0));
+  return true;
+}
+
+/* filled (thickness < 0) or outlined polygon */
+static void
+gst_markerdetect_draw_polygon (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img,
+    const cv::Point *points, int count, const cv::Scalar &color, int thickness)
+{
+  if ( img->format == GST_VIDEO_FORMAT_BGR )
+  {
+    if ( thickness < 0 )
+      cv::fillPoly(img->bgr, &points, &count, 1, color);
+    else
+      cv::polylines(img->bgr, &points, &count, 1, true, color, thickness, cv::LINE_AA);
+    return;
+  }
+
+  // bounding box (as cv::boundingRect), and the polygon relative to it
+  int x0 = points[0].x, y0 = points[0].y, x1 = x0, y1 = y0;
+  for ( int i = 1; i < count; i++ )
+  {
+    x0 = MIN(x0, points[i].x); x1 = MAX(x1, points[i].x);
+    y0 = MIN(y0, points[i].y); y1 = MAX(y1, points[i].y);
+  }
+  int margin = MAX(thickness, 0) + 1;
+  cv::Rect roi(x0 - margin, y0 - margin, x1 - x0 + 1 + 2*margin, y1 - y0 + 1 + 2*margin);
+  cv::Mat1b mask;
+  if ( !gst_markerdetect_draw_mask(markerdetect, img, roi, mask) )
+    return;
+  cv::Point local[GST_MARKERDETECT_POLYGON_MAX];
+  const cv::Point *localPoints = local;
+  count = MIN(count, GST_MARKERDETECT_POLYGON_MAX);
+  for ( int i = 0; i < count; i++ ) local[i] = points[i] - roi.tl();
+  if ( thickness < 0 )
+    cv::fillPoly(mask, &localPoints, &count, 1, cv::Scalar(255));
+  else
+    cv::polylines(mask, &localPoints, &count, 1, true, cv::Scalar(255), thickness, cv::LINE_AA);
+  gst_markerdetect_blend_mask(markerdetect, img, roi, mask, color, NULL);
+}
+
+/* text (Hershey fonts, anti-aliased) */
+static void
+gst_markerdetect_draw_text (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img,
+    const std::string &text, cv::Point org, int fontFace, double fontScale, const cv::Scalar &color, int thickness)
+{
+  if ( img->format == GST_VIDEO_FORMAT_BGR )
+  {
+    cv::putText(img->bgr, text, org, fontFace, fontScale, color, thickness, cv::LINE_AA);
+    return;
+  }
+
+  int baseline = 0;
+  cv::Size size = cv::getTextSize(text, fontFace, fontScale, thickness, &baseline);
+  int margin = thickness + 1;
+  cv::Rect roi(org.x - margin, org.y - size.height - margin, size.width + 2*margin, size.height + baseline + 2*margin);
+  cv::Mat1b mask;
+  if ( !gst_markerdetect_draw_mask(markerdetect, img, roi, mask) )
+    return;
+  // the text may be clipped by the frame, so draw it relative to the clipped box
+  cv::putText(mask, text, org - roi.tl(), fontFace, fontScale, cv::Scalar(255), thickness, cv::LINE_AA);
+  gst_markerdetect_blend_mask(markerdetect, img, roi, mask, color, NULL);
+}
+
+/* warp a BGR image onto a quad of the frame (replacing the quad's content) */
+static void
+gst_markerdetect_draw_image (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img,
+    const cv::Mat &image, const cv::Point2f dstPoints[4])
+{
+  const cv::Point2f srcPoints[4] = {
+    cv::Point2f(           0,            0), // top left
+    cv::Point2f(image.cols-1,            0), // top right
+    cv::Point2f(image.cols-1, image.rows-1), // bottom right
+    cv::Point2f(           0, image.rows-1)  // bottom left
+  };
+  cv::Matx33d h = gst_markerdetect_homography(srcPoints, dstPoints);
+  cv::Point quad[4];
+  for( int i = 0; i < 4; i++)
+  {
+    quad[i] = dstPoints[i];
+  }
+  int x0 = quad[0].x, y0 = quad[0].y, x1 = x0, y1 = y0;
+  for ( int i = 1; i < 4; i++ )
+  {
+    x0 = MIN(x0, quad[i].x); x1 = MAX(x1, quad[i].x);
+    y0 = MIN(y0, quad[i].y); y1 = MAX(y1, quad[i].y);
+  }
+
+  cv::Rect roi(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+  cv::Mat1b mask;
+  if ( !gst_markerdetect_draw_mask(markerdetect, img, roi, mask) )
+    return;
+  // Warp image into the quad's bounding box only
+  cv::Matx33d t(1, 0, -roi.x, 0, 1, -roi.y, 0, 0, 1);
+  cv::Mat warped = markerdetect->context->drawImage(cv::Rect(0, 0, roi.width, roi.height));
+  for ( int i = 0; i < 4; i++ ) quad[i] -= roi.tl();
+  cv::warpPerspective(image, warped, t*h, roi.size());
+  cv::fillConvexPoly(mask, quad, 4, cv::Scalar(255), cv::LINE_AA);
+  gst_markerdetect_blend_mask(markerdetect, img, roi, mask, cv::Scalar(0), &warped);
+}
+
+/* detected marker outlines and IDs (same layout as cv::aruco::drawDetectedMarkers) */
+static void
+gst_markerdetect_draw_markers (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img,
+    const std::vector<std::vector<cv::Point2f>> &markerCorners, const std::vector<int> &markerIds)
+{
+  if ( img->format == GST_VIDEO_FORMAT_BGR )
+  {
+    cv::aruco::drawDetectedMarkers(img->bgr, markerCorners, markerIds);
+    return;
+  }
+
+  for ( unsigned i = 0; i < markerCorners.size(); i++ )
+  {
+    const std::vector<cv::Point2f> &corners = markerCorners[i];
+    const cv::Point outline[4] = { corners[0], corners[1], corners[2], corners[3] };
+    gst_markerdetect_draw_polygon(markerdetect, img, outline, 4, cv::Scalar(0,255,0), 1);
+    const cv::Point firstCorner[4] = {
+      outline[0] + cv::Point(-3,-3), outline[0] + cv::Point(3,-3),
+      outline[0] + cv::Point(3,3), outline[0] + cv::Point(-3,3)
+    };
+    gst_markerdetect_draw_polygon(markerdetect, img, firstCorner, 4, cv::Scalar(255,0,0), 1);
+    cv::Point2f cent = (corners[0] + corners[1] + corners[2] + corners[3]) * 0.25;
+    gst_markerdetect_draw_text(markerdetect, img, gst_markerdetect_label(markerdetect, "id=%d", markerIds[i]), cv::Point(cent.x, cent.y),
+      cv::FONT_HERSHEY_SIMPLEX, 0.5, cv::Scalar(0,0,255), 2);
+  }
+}
+
+//
+// Text layer
+//
+// Hershey text with anti-aliasing is costly, and chart 1 shows about 70 labels.
+// Each label is rendered once (coverage only) into its own slot of a small
+// atlas, and re-rendered only when the values shown or the settings change.
+// The glyphs are blended into every frame at the current label anchors, so
+// the labels follow the chart without rendering any text.
+//
+
+/* render a label into the atlas slot of a glyph (same layout as gst_markerdetect_draw_text) */
+static void
+gst_markerdetect_layer_text (GstMarkerDetect *markerdetect, int glyph, const std::string &text,
+    int fontFace, double fontScale, int thickness)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  GstMarkerDetectGlyph &g = context->textGlyphs[glyph];
+
+  int baseline = 0;
+  cv::Size size = cv::getTextSize(text, fontFace, fontScale, thickness, &baseline);
+  int margin = thickness + 1;
+  g.offset = cv::Point(-margin, -size.height - margin);
+  g.roi = cv::Rect(0, glyph * GST_MARKERDETECT_TEXT_SLOT_HEIGHT,
+    MIN(size.width + 2*margin, GST_MARKERDETECT_TEXT_SLOT_WIDTH),
+    MIN(size.height + baseline + 2*margin, GST_MARKERDETECT_TEXT_SLOT_HEIGHT));
+
+  cv::Mat1b coverage = context->textAtlas(g.roi);
+  coverage.setTo(cv::Scalar(0));
+  cv::putText(coverage, text, -g.offset, fontFace, fontScale, cv::Scalar(255), thickness, cv::LINE_AA);
+}
+
+/* blend a glyph into the frame, with its text origin at org */
+static void
+gst_markerdetect_layer_blit (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, int glyph,
+    cv::Point org, const cv::Scalar &color)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  const GstMarkerDetectGlyph &g = context->textGlyphs[glyph];
+
+  cv::Rect box(org + g.offset, g.roi.size());
+  cv::Rect roi = box & cv::Rect(0, 0, img->width, img->height);
+  if ( roi.empty() )
+    return;
+  const cv::Mat1b mask = context->textAtlas(cv::Rect(g.roi.tl() + (roi.tl() - box.tl()), roi.size()));
+  gst_markerdetect_blend_mask(markerdetect, img, roi, mask, color, NULL);
+}
+
+/* Color Checker labels : the E[UV] of each patch (glyphs 0-23), then 4 per color space */
+static const char *const chartTextNames[5][4] = {
+  { "E[BGR]", " E[B]", " E[G]", " E[R]" },
+  { "E[UV]",  " E[Y]", " E[U]", " E[V]" },
+  { "E[LAB]", " E[L]", " E[A]", " E[B]" },
+  { "E[HSV]", " E[H]", " E[S]", " E[V]" },
+  { "E[XYZ]", " E[X]", " E[Y]", " E[Z]" }
+};
+
+/* render the Color Checker labels (patch errors, and the error of each color space) into the text layer */
+static void
+gst_markerdetect_layer_chart_text (GstMarkerDetect *markerdetect, const GstMarkerDetectTextKey *key)
+{
+  for ( int i = 0; i < 24; i++ )
+  {
+    // correctness score alone in the colored patch, or labelled on the patch outline
+    const char *format = key->showErrors ? "%u" : "E[UV]%u";
+    gst_markerdetect_layer_text(markerdetect, i, gst_markerdetect_label(markerdetect, format, key->patchErrors[i]),
+      cv::FONT_HERSHEY_PLAIN, 1.0, 1);
+  }
+
+  for ( int s = 0; s < 5; s++ )
+  {
+    for ( int c = 0; c < 4; c++ )
+    {
+      const char *name = chartTextNames[s][c];
+      if ( (s == 2) && (c == 0) && (key->deltaE == GST_MARKERDETECT_DELTA_E_CIEDE2000) )
+        name = "E[DE00]";
+      gst_markerdetect_layer_text(markerdetect, 24 + s*4 + c,
+        gst_markerdetect_label(markerdetect, "%s=%u", name, key->chartErrors[s][c]), cv::FONT_HERSHEY_PLAIN, 1.0, 1);
+    }
+  }
+}
+
+/* blend the Color Checker labels into the frame, at the patch corners of the current pose */
+static void
+gst_markerdetect_layer_chart_blit (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img,
+    const GstMarkerDetectResult *result, bool showErrors)
+{
+  // totals in dark blue, BGR components in their color, other components in black
+  static const cv::Scalar totalColor(99,31,0);
+  static const cv::Scalar bgrColors[3] = { cv::Scalar(255,0,0), cv::Scalar(0,255,0), cv::Scalar(0,0,255) };
+  static const cv::Scalar black(0,0,0);
+  static const cv::Scalar white(255,255,255);
+
+  for ( int i = 0; i < 24; i++ )
+  {
+    const cv::Point2f *patchCorners = result->patchCorners[i];
+    cv::Point topLeft(patchCorners[0].x, patchCorners[0].y);
+    cv::Point bottomLeft(patchCorners[3].x, patchCorners[3].y);
+    if ( showErrors )
+    {
+      gst_markerdetect_layer_blit(markerdetect, img, i, bottomLeft + cv::Point(5,-5), black);
+    }
+    else
+    {
+      gst_markerdetect_layer_blit(markerdetect, img, i, topLeft, black);
+      gst_markerdetect_layer_blit(markerdetect, img, i, bottomLeft, white);
+    }
+  }
+
+  // one block of 4 lines per color space
+  int y_offset = 20;
+  for ( int s = 0; s < 5; s++, y_offset += 100 )
+  {
+    for ( int c = 0; c < 4; c++ )
+    {
+      const cv::Scalar &color = (c == 0) ? totalColor : ((s == 0) ? bgrColors[c-1] : black);
+      gst_markerdetect_layer_blit(markerdetect, img, 24 + s*4 + c, cv::Point(10,y_offset+20*(c+1)), color);
+    }
+  }
+}
+
+void
+gst_markerdetect_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (object);
+
+  GST_DEBUG_OBJECT (markerdetect, "set_property");
+
+  switch (property_id) {
+    case PROP_CC_SCRIPT:
+      GST_OBJECT_LOCK (markerdetect);
+      g_free (markerdetect->cc_script);
+      markerdetect->cc_script = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_CC_EXTRA_ARGS:
+      GST_OBJECT_LOCK (markerdetect);
+      g_free (markerdetect->cc_extra_args);
+      markerdetect->cc_extra_args = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_CC_SKIP_FRAMES:
+      markerdetect->cc_skip_frames = g_value_get_int (value);
+      break;
+    case PROP_CC_SHOW_GT:
+      markerdetect->cc_show_gt = g_value_get_boolean (value);
+      break;
+    case PROP_CC_SHOW_EC:
+      markerdetect->cc_show_ec = g_value_get_boolean (value);
+      break;
+    case PROP_WB_SCRIPT:
+      GST_OBJECT_LOCK (markerdetect);
+      g_free (markerdetect->wb_script);
       markerdetect->wb_script = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (markerdetect);
       break;
     case PROP_WB_EXTRA_ARGS:
+      GST_OBJECT_LOCK (markerdetect);
       g_free (markerdetect->wb_extra_args);
       markerdetect->wb_extra_args = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_WB_SKIP_FRAMES:
+      markerdetect->wb_skip_frames = g_value_get_int (value);
+      break;
+    case PROP_DICTIONARY:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->dictionary = g_value_get_enum (value);
+      markerdetect->detector_dirty = TRUE;
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_ADAPTIVE_THRESH_WIN_SIZE_MIN:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->adaptive_thresh_win_size_min = g_value_get_int (value);
+      markerdetect->detector_dirty = TRUE;
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_ADAPTIVE_THRESH_WIN_SIZE_MAX:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->adaptive_thresh_win_size_max = g_value_get_int (value);
+      markerdetect->detector_dirty = TRUE;
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_ADAPTIVE_THRESH_WIN_SIZE_STEP:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->adaptive_thresh_win_size_step = g_value_get_int (value);
+      markerdetect->detector_dirty = TRUE;
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_MIN_MARKER_PERIMETER_RATE:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->min_marker_perimeter_rate = g_value_get_double (value);
+      markerdetect->detector_dirty = TRUE;
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_MAX_MARKER_PERIMETER_RATE:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->max_marker_perimeter_rate = g_value_get_double (value);
+      markerdetect->detector_dirty = TRUE;
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_CORNER_REFINEMENT_METHOD:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->corner_refinement_method = g_value_get_enum (value);
+      markerdetect->detector_dirty = TRUE;
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_REDUCED_DICTIONARY:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->reduced_dictionary = g_value_get_boolean (value);
+      markerdetect->detector_dirty = TRUE;
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_DETECT_SCALE:
+      markerdetect->detect_scale = g_value_get_int (value);
+      break;
+    case PROP_DETECT_TILES:
+      markerdetect->detect_tiles = g_value_get_int (value);
+      break;
+    case PROP_TRACK:
+      markerdetect->track = g_value_get_boolean (value);
+      break;
+    case PROP_TRACK_REACQUIRE_INTERVAL:
+      markerdetect->track_reacquire_interval = g_value_get_int (value);
+      break;
+    case PROP_TRACK_PADDING:
+      markerdetect->track_padding = g_value_get_double (value);
+      break;
+    case PROP_DETECT_INTERVAL:
+      markerdetect->detect_interval = g_value_get_uint (value);
+      break;
+    case PROP_MOTION_THRESHOLD:
+      markerdetect->motion_threshold = g_value_get_double (value);
+      break;
+    case PROP_PRESENCE_FILTER:
+      markerdetect->presence_filter = g_value_get_boolean (value);
+      break;
+    case PROP_PRESENCE_SCAN_INTERVAL:
+      markerdetect->presence_scan_interval = g_value_get_uint (value);
+      break;
+    case PROP_ASYNC:
+      markerdetect->async = g_value_get_boolean (value);
+      break;
+    case PROP_QUEUE_DEPTH:
+      markerdetect->queue_depth = g_value_get_int (value);
+      break;
+    case PROP_WORKER_CPU:
+      markerdetect->worker_cpu = g_value_get_int (value);
+      break;
+    case PROP_WORKER_POOL:
+      markerdetect->worker_pool = g_value_get_enum (value);
+      break;
+    case PROP_GROUP:
+      GST_OBJECT_LOCK (markerdetect);
+      g_free (markerdetect->group);
+      markerdetect->group = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_DELTA_E:
+      markerdetect->delta_e = g_value_get_enum (value);
+      break;
+    case PROP_POST_MESSAGES:
+      markerdetect->post_messages = g_value_get_boolean (value);
+      break;
+    case PROP_SCRIPT_MODE:
+      GST_OBJECT_LOCK (markerdetect);
+      markerdetect->script_mode = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_ATTACH_META:
+      markerdetect->attach_meta = g_value_get_boolean (value);
+      break;
+    case PROP_OVERLAY:
+      markerdetect->overlay = g_value_get_enum (value);
+      // without overlay, frames are only read : no need for writable buffers
+      gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (markerdetect),
+          markerdetect->overlay == GST_MARKERDETECT_OVERLAY_NONE);
+      break;
+    case PROP_OVERLAY_REFRESH_INTERVAL:
+      markerdetect->overlay_refresh_interval = g_value_get_uint (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      markerdetect->stats_interval = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_markerdetect_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (object);
+
+  GST_DEBUG_OBJECT (markerdetect, "get_property");
+
+  switch (property_id) {
+    case PROP_CC_SCRIPT:
+      GST_OBJECT_LOCK (markerdetect);
+      g_value_set_string (value, markerdetect->cc_script);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_CC_EXTRA_ARGS:
+      GST_OBJECT_LOCK (markerdetect);
+      g_value_set_string (value, markerdetect->cc_extra_args);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_CC_SKIP_FRAMES:
+      g_value_set_int (value, markerdetect->cc_skip_frames);
+      break;      
+    case PROP_CC_SHOW_GT:
+      g_value_set_boolean (value, markerdetect->cc_show_gt);
+      break;      
+    case PROP_CC_SHOW_EC:
+      g_value_set_boolean (value, markerdetect->cc_show_ec);
+      break;      
+    case PROP_WB_SCRIPT:
+      GST_OBJECT_LOCK (markerdetect);
+      g_value_set_string (value, markerdetect->wb_script);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_WB_EXTRA_ARGS:
+      GST_OBJECT_LOCK (markerdetect);
+      g_value_set_string (value, markerdetect->wb_extra_args);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_WB_SKIP_FRAMES:
+      g_value_set_int (value, markerdetect->wb_skip_frames);
+      break;      
+    case PROP_DICTIONARY:
+      g_value_set_enum (value, markerdetect->dictionary);
+      break;
+    case PROP_ADAPTIVE_THRESH_WIN_SIZE_MIN:
+      g_value_set_int (value, markerdetect->adaptive_thresh_win_size_min);
+      break;
+    case PROP_ADAPTIVE_THRESH_WIN_SIZE_MAX:
+      g_value_set_int (value, markerdetect->adaptive_thresh_win_size_max);
+      break;
+    case PROP_ADAPTIVE_THRESH_WIN_SIZE_STEP:
+      g_value_set_int (value, markerdetect->adaptive_thresh_win_size_step);
+      break;
+    case PROP_MIN_MARKER_PERIMETER_RATE:
+      g_value_set_double (value, markerdetect->min_marker_perimeter_rate);
+      break;
+    case PROP_MAX_MARKER_PERIMETER_RATE:
+      g_value_set_double (value, markerdetect->max_marker_perimeter_rate);
+      break;
+    case PROP_CORNER_REFINEMENT_METHOD:
+      g_value_set_enum (value, markerdetect->corner_refinement_method);
+      break;
+    case PROP_REDUCED_DICTIONARY:
+      g_value_set_boolean (value, markerdetect->reduced_dictionary);
+      break;
+    case PROP_DETECT_SCALE:
+      g_value_set_int (value, markerdetect->detect_scale);
+      break;
+    case PROP_DETECT_TILES:
+      g_value_set_int (value, markerdetect->detect_tiles);
+      break;
+    case PROP_TRACK:
+      g_value_set_boolean (value, markerdetect->track);
+      break;
+    case PROP_TRACK_REACQUIRE_INTERVAL:
+      g_value_set_int (value, markerdetect->track_reacquire_interval);
+      break;
+    case PROP_TRACK_PADDING:
+      g_value_set_double (value, markerdetect->track_padding);
+      break;
+    case PROP_DETECT_INTERVAL:
+      g_value_set_uint (value, markerdetect->detect_interval);
+      break;
+    case PROP_MOTION_THRESHOLD:
+      g_value_set_double (value, markerdetect->motion_threshold);
+      break;
+    case PROP_PRESENCE_FILTER:
+      g_value_set_boolean (value, markerdetect->presence_filter);
+      break;
+    case PROP_PRESENCE_SCAN_INTERVAL:
+      g_value_set_uint (value, markerdetect->presence_scan_interval);
+      break;
+    case PROP_ASYNC:
+      g_value_set_boolean (value, markerdetect->async);
+      break;
+    case PROP_QUEUE_DEPTH:
+      g_value_set_int (value, markerdetect->queue_depth);
+      break;
+    case PROP_WORKER_CPU:
+      g_value_set_int (value, markerdetect->worker_cpu);
+      break;
+    case PROP_WORKER_POOL:
+      g_value_set_enum (value, markerdetect->worker_pool);
+      break;
+    case PROP_GROUP:
+      GST_OBJECT_LOCK (markerdetect);
+      g_value_set_string (value, markerdetect->group);
+      GST_OBJECT_UNLOCK (markerdetect);
+      break;
+    case PROP_DELTA_E:
+      g_value_set_enum (value, markerdetect->delta_e);
+      break;
+    case PROP_POST_MESSAGES:
+      g_value_set_boolean (value, markerdetect->post_messages);
+      break;
+    case PROP_SCRIPT_MODE:
+      g_value_set_enum (value, markerdetect->script_mode);
+      break;
+    case PROP_ATTACH_META:
+      g_value_set_boolean (value, markerdetect->attach_meta);
+      break;
+    case PROP_OVERLAY:
+      g_value_set_enum (value, markerdetect->overlay);
+      break;
+    case PROP_OVERLAY_REFRESH_INTERVAL:
+      g_value_set_uint (value, markerdetect->overlay_refresh_interval);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, markerdetect->stats_interval);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value, gst_markerdetect_stats_structure (markerdetect));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_markerdetect_dispose (GObject * object)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (object);
+
+  GST_DEBUG_OBJECT (markerdetect, "dispose");
+
+  /* clean up as possible.  may be called multiple times */
+
+  G_OBJECT_CLASS (gst_markerdetect_parent_class)->dispose (object);
+}
+
+/* stop the analysis worker (if any), and release the detector context */
+static void
+gst_markerdetect_free_context (GstMarkerDetect *markerdetect)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  if ( context == NULL )
+    return;
+
+  gst_markerdetect_stop_worker(markerdetect);
+  gst_markerdetect_group_leave(markerdetect);
+  gst_markerdetect_coprocess_stop(&context->ccCoprocess);
+  gst_markerdetect_coprocess_stop(&context->wbCoprocess);
+  // drop queued script runs, wait for the running ones
+  g_thread_pool_free (context->ccScriptPool, TRUE, TRUE);
+  g_thread_pool_free (context->wbScriptPool, TRUE, TRUE);
+  g_mutex_clear (&context->jobLock);
+  g_cond_clear (&context->jobCond);
+  if ( context->chartPool != NULL )
+  {
+    gst_buffer_pool_set_active (context->chartPool, FALSE);
+    gst_object_unref (context->chartPool);
+  }
+
+  GST_OBJECT_LOCK (markerdetect);
+  delete context;
+  markerdetect->context = NULL;
+  GST_OBJECT_UNLOCK (markerdetect);
+}
+
+void
+gst_markerdetect_finalize (GObject * object)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (object);
+
+  GST_DEBUG_OBJECT (markerdetect, "finalize");
+
+  /* clean up object here */
+  g_free (markerdetect->cc_script);
+  g_free (markerdetect->cc_extra_args);
+  g_free (markerdetect->wb_script);
+  g_free (markerdetect->wb_extra_args);
+  g_free (markerdetect->group);
+  gst_markerdetect_free_context(markerdetect);
+  g_mutex_clear (&markerdetect->stats->lock);
+  g_free (markerdetect->stats);
+
+  G_OBJECT_CLASS (gst_markerdetect_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_markerdetect_start (GstBaseTransform * trans)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (trans);
+
+  GST_DEBUG_OBJECT (markerdetect, "start");
+
+  GST_OBJECT_LOCK (markerdetect);
+  if ( markerdetect->context == NULL )
+  {
+    markerdetect->context = new GstMarkerDetectContext();
+    g_mutex_init (&markerdetect->context->jobLock);
+    g_cond_init (&markerdetect->context->jobCond);
+    gst_markerdetect_init_references(markerdetect->context);
+    markerdetect->context->ccScriptPool = g_thread_pool_new(gst_markerdetect_run_script, markerdetect, 1, FALSE, NULL);
+    markerdetect->context->wbScriptPool = g_thread_pool_new(gst_markerdetect_run_script, markerdetect, 1, FALSE, NULL);
+  }
+  gst_markerdetect_build_context(markerdetect);
+  bool coprocess = (markerdetect->script_mode == GST_MARKERDETECT_SCRIPT_MODE_COPROCESS);
+  GST_OBJECT_UNLOCK (markerdetect);
+
+  if ( coprocess )
+  {
+    gst_markerdetect_coprocess_start(markerdetect, &markerdetect->context->ccCoprocess,
+      &markerdetect->cc_script, &markerdetect->cc_extra_args, "markerdetect-cc");
+    gst_markerdetect_coprocess_start(markerdetect, &markerdetect->context->wbCoprocess,
+      &markerdetect->wb_script, &markerdetect->wb_extra_args, "markerdetect-wb");
+  }
+  if ( markerdetect->async )
+  {
+    gst_markerdetect_start_worker(markerdetect);
+  }
+
+  return TRUE;
+}
+
+static gboolean
+gst_markerdetect_stop (GstBaseTransform * trans)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (trans);
+
+  GST_DEBUG_OBJECT (markerdetect, "stop");
+
+  gst_markerdetect_free_context(markerdetect);
+  GST_OBJECT_LOCK (markerdetect);
+  markerdetect->detector_dirty = TRUE;
+  GST_OBJECT_UNLOCK (markerdetect);
+
+  return TRUE;
+}
+
+static gboolean
+gst_markerdetect_set_info (GstVideoFilter * filter, GstCaps * incaps,
+    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (filter);
+
+  GST_DEBUG_OBJECT (markerdetect, "set_info");
+
+  // The analysis worker reads the colorimetry and the frame geometry below : it is
+  // stopped while they change (dropping the frames queued with the previous caps),
+  // and restarted once they are updated
+  bool restartWorker = (markerdetect->context != NULL) && markerdetect->context->async;
+  if ( restartWorker )
+  {
+    gst_markerdetect_stop_worker(markerdetect);
+  }
+
+  GST_OBJECT_LOCK (markerdetect);
+  if ( (markerdetect->context != NULL) && !markerdetect->context->async && markerdetect->detector_dirty )
+  {
+    gst_markerdetect_build_context(markerdetect);
+  }
+  // the chart pad follows the input format and frame rate
+  markerdetect->chart_pad_pending = TRUE;
+  GST_OBJECT_UNLOCK (markerdetect);
+
+  if ( markerdetect->context != NULL )
+  {
+    GstMarkerDetectContext *context = markerdetect->context;
+    gst_markerdetect_set_colorimetry(markerdetect, in_info);
+    context->drawMask.create(GST_VIDEO_INFO_HEIGHT(in_info), GST_VIDEO_INFO_WIDTH(in_info));
+    context->drawImage.create(GST_VIDEO_INFO_HEIGHT(in_info), GST_VIDEO_INFO_WIDTH(in_info), CV_8UC3);
+    // the rest of the per frame workspace does not depend on the frame size, size it once here too
+    context->plotImage.create(100, 100, CV_8UC3);
+    context->histImage.create(400, 512, CV_8UC3);
+    context->histNorm.create(256, 1, CV_32F);
+    context->chartMapF.create(GST_MARKERDETECT_CHART_HEIGHT, GST_MARKERDETECT_CHART_WIDTH);
+    context->label.reserve(GST_MARKERDETECT_LABEL_SIZE);
+    context->groupName.reserve(GST_MARKERDETECT_LABEL_SIZE);
+    // text layer : one atlas slot per glyph, rendered on the first chart
+    context->textAtlas.create(GST_MARKERDETECT_TEXT_GLYPHS * GST_MARKERDETECT_TEXT_SLOT_HEIGHT, GST_MARKERDETECT_TEXT_SLOT_WIDTH);
+    context->textValid = false;
+    context->textLatched = false;
+  }
+
+  if ( restartWorker )
+  {
+    // the result of a previous caps frame must not be drawn on the new ones
+    GstMarkerDetectContext *context = markerdetect->context;
+    context->drawResult.chart = 0;
+    context->drawResult.markerIds.clear();
+    context->drawResult.markerCorners.clear();
+    gst_markerdetect_start_worker(markerdetect);
+  }
+
+  return TRUE;
+}
+
+/* transform */
+static GstFlowReturn
+gst_markerdetect_transform_frame (GstVideoFilter * filter, GstVideoFrame * inframe,
+    GstVideoFrame * outframe)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (filter);
+
+  GST_DEBUG_OBJECT (markerdetect, "transform_frame");
+
+  return GST_FLOW_OK;
+}
+
+/* run a chart script (on the script thread, never on the streaming thread) */
+static void
+gst_markerdetect_run_script (gpointer data, gpointer user_data)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (user_data);
+  gchar **argv = (gchar **) data;
+  GError *error = NULL;
+
+  if ( !g_spawn_sync(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, NULL, NULL, NULL, &error) )
+  {
+    GST_WARNING_OBJECT (markerdetect, "could not run %s : %s", argv[0], error->message);
+    g_error_free (error);
+  }
+  g_strfreev (argv);
+}
+
+/* script command line : script, values, extra arguments (NULL on error) */
+static gchar **
+gst_markerdetect_script_argv (GstMarkerDetect *markerdetect, const gchar *script, const gchar *extra_args,
+    const int *values, int count)
+{
+  gchar **scriptArgv = NULL;
+  gchar **extraArgv = NULL;
+  GError *error = NULL;
+
+  // script and extra arguments keep their shell-like quoting, but no shell is involved
+  if ( !g_shell_parse_argv(script, NULL, &scriptArgv, &error) )
+  {
+    GST_WARNING_OBJECT (markerdetect, "invalid script %s : %s", script, error->message);
+    g_error_free (error);
+    return NULL;
+  }
+  if ( (extra_args != NULL) && (extra_args[0] != '\0') && !g_shell_parse_argv(extra_args, NULL, &extraArgv, &error) )
+  {
+    GST_WARNING_OBJECT (markerdetect, "invalid extra arguments %s : %s", extra_args, error->message);
+    g_clear_error (&error);
+  }
+
+  GPtrArray *argv = g_ptr_array_new();
+  for ( gchar **arg = scriptArgv; *arg != NULL; arg++ )
+    g_ptr_array_add(argv, g_strdup(*arg));
+  for ( int i = 0; i < count; i++ )
+    g_ptr_array_add(argv, g_strdup_printf("%d", values[i]));
+  for ( gchar **arg = extraArgv; (arg != NULL) && (*arg != NULL); arg++ )
+    g_ptr_array_add(argv, g_strdup(*arg));
+  g_ptr_array_add(argv, NULL);
+  g_strfreev (scriptArgv);
+  g_strfreev (extraArgv);
+
+  return (gchar **) g_ptr_array_free(argv, FALSE);
+}
+
+/* queue a script run, with the measured values as arguments (skipped, and counted in the stats,
+   while a run of the same script is pending) */
+static void
+gst_markerdetect_queue_script (GstMarkerDetect *markerdetect, GThreadPool *pool, const gchar *script,
+    const gchar *extra_args, const int *values, int count)
+{
+  if ( g_thread_pool_unprocessed(pool) > 0 )
+  {
+    GstMarkerDetectStats *stats = markerdetect->stats;
+    g_mutex_lock (&stats->lock);
+    guint64 dropped = ++stats->droppedScripts;
+    g_mutex_unlock (&stats->lock);
+    GST_DEBUG_OBJECT (markerdetect, "previous %s run still pending, skipped (%" G_GUINT64_FORMAT " skipped)",
+        script, dropped);
+    return;
+  }
+  gchar **argv = gst_markerdetect_script_argv(markerdetect, script, extra_args, values, count);
+  if ( argv != NULL )
+  {
+    g_thread_pool_push(pool, argv, NULL);
+  }
+}
+
+//
+// Script co-process (script-mode=coprocess)
+//
+// The script is spawned once, and each measurement is written to its stdin as
+// a line of space separated values (the same values as the command line
+// arguments of script-mode=spawn). A writer thread per script keeps the
+// analysis from ever blocking on the pipe : only the latest record waits to be
+// written, and records are dropped while the pipe is full. The script is
+// restarted (at most once per second) when it exits.
+//
+
+/* (re)spawn the co-process, with a non-blocking pipe to its stdin */
+static bool
+gst_markerdetect_coprocess_spawn (GstMarkerDetect *markerdetect, GstMarkerDetectCoprocess *coprocess)
+{
+  gchar **argv;
+  GError *error = NULL;
+  GPid pid;
+  gint fd;
+
+  GST_OBJECT_LOCK (markerdetect);
+  const gchar *script = coprocess->script ? *coprocess->script : NULL;
+  const gchar *extra_args = coprocess->extra_args ? *coprocess->extra_args : NULL;
+  argv = (script != NULL) ? gst_markerdetect_script_argv(markerdetect, script, extra_args, NULL, 0) : NULL;
+  GST_OBJECT_UNLOCK (markerdetect);
+  if ( argv == NULL )
+    return false;
+
+  coprocess->spawnTime = g_get_monotonic_time();
+  if ( !g_spawn_async_with_pipes(NULL, argv, NULL, G_SPAWN_SEARCH_PATH, NULL, NULL, &pid, &fd, NULL, NULL, &error) )
+  {
+    GST_WARNING_OBJECT (markerdetect, "could not start %s : %s", argv[0], error->message);
+    g_error_free (error);
+    g_strfreev (argv);
+    return false;
+  }
+  GST_INFO_OBJECT (markerdetect, "started %s co-process", argv[0]);
+  g_strfreev (argv);
+  // the child is reaped by glib (no G_SPAWN_DO_NOT_REAP_CHILD)
+  g_spawn_close_pid (pid);
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  coprocess->fd = fd;
+  return true;
+}
+
+/* co-process writer thread */
+static gpointer
+gst_markerdetect_coprocess_writer (gpointer data)
+{
+  GstMarkerDetectCoprocess *coprocess = (GstMarkerDetectCoprocess *) data;
+  GstMarkerDetect *markerdetect = coprocess->markerdetect;
+  // swapped with the pending record : both keep their capacity
+  std::string record;
+  record.reserve(GST_MARKERDETECT_RECORD_SIZE);
+
+  // a child that exited must show up as EPIPE, not kill the process with SIGPIPE
+  sigset_t sigpipe;
+  sigemptyset(&sigpipe);
+  sigaddset(&sigpipe, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &sigpipe, NULL);
+
+  g_mutex_lock (&coprocess->lock);
+  while ( true )
+  {
+    while ( !coprocess->stop && !coprocess->hasRecord )
+    {
+      g_cond_wait (&coprocess->cond, &coprocess->lock);
+    }
+    if ( coprocess->stop )
       break;
-    case PROP_WB_SKIP_FRAMES:
-      markerdetect->wb_skip_frames = g_value_get_int (value);
+    record.swap(coprocess->record);
+    coprocess->hasRecord = false;
+    g_mutex_unlock (&coprocess->lock);
+
+    if ( coprocess->fd < 0 && (g_get_monotonic_time() - coprocess->spawnTime) >= G_USEC_PER_SEC )
+    {
+      gst_markerdetect_coprocess_spawn(markerdetect, coprocess);
+    }
+    if ( coprocess->fd >= 0 )
+    {
+      // records are shorter than PIPE_BUF, so they are written whole or not at all
+      ssize_t written = write(coprocess->fd, record.data(), record.size());
+      if ( written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) )
+      {
+        coprocess->dropped++;
+        GST_LOG_OBJECT (markerdetect, "co-process pipe full, record dropped (%" G_GUINT64_FORMAT " dropped)", coprocess->dropped);
+      }
+      else if ( written < 0 )
+      {
+        GST_WARNING_OBJECT (markerdetect, "co-process exited (%s), restarting", g_strerror(errno));
+        close(coprocess->fd);
+        coprocess->fd = -1;
+      }
+    }
+
+    g_mutex_lock (&coprocess->lock);
+  }
+  g_mutex_unlock (&coprocess->lock);
+
+  if ( coprocess->fd >= 0 )
+  {
+    // end of input : the script is expected to exit
+    close(coprocess->fd);
+    coprocess->fd = -1;
+  }
+  return NULL;
+}
+
+static void
+gst_markerdetect_coprocess_start (GstMarkerDetect *markerdetect, GstMarkerDetectCoprocess *coprocess,
+    gchar **script, gchar **extra_args, const gchar *name)
+{
+  coprocess->markerdetect = markerdetect;
+  coprocess->script = script;
+  coprocess->extra_args = extra_args;
+  coprocess->fd = -1;
+  coprocess->spawnTime = g_get_monotonic_time() - G_USEC_PER_SEC;
+  coprocess->stop = false;
+  coprocess->hasRecord = false;
+  coprocess->dropped = 0;
+  coprocess->record.reserve(GST_MARKERDETECT_RECORD_SIZE);
+  g_mutex_init (&coprocess->lock);
+  g_cond_init (&coprocess->cond);
+  coprocess->thread = g_thread_new(name, gst_markerdetect_coprocess_writer, coprocess);
+}
+
+static void
+gst_markerdetect_coprocess_stop (GstMarkerDetectCoprocess *coprocess)
+{
+  if ( coprocess->thread == NULL )
+    return;
+
+  g_mutex_lock (&coprocess->lock);
+  coprocess->stop = true;
+  g_cond_signal (&coprocess->cond);
+  g_mutex_unlock (&coprocess->lock);
+  g_thread_join (coprocess->thread);
+  coprocess->thread = NULL;
+  g_mutex_clear (&coprocess->lock);
+  g_cond_clear (&coprocess->cond);
+}
+
+/* hand a record to the writer thread (replacing the one not written yet) */
+static void
+gst_markerdetect_coprocess_send (GstMarkerDetectCoprocess *coprocess, const int *values, int count)
+{
+  g_mutex_lock (&coprocess->lock);
+  if ( coprocess->hasRecord )
+    coprocess->dropped++;
+  coprocess->record.clear();
+  for ( int i = 0; i < count; i++ )
+  {
+    char value[16];
+    int n = snprintf(value, sizeof(value), (i == count-1) ? "%d\n" : "%d ", values[i]);
+    coprocess->record.append(value, n);
+  }
+  coprocess->hasRecord = true;
+  g_cond_signal (&coprocess->cond);
+  g_mutex_unlock (&coprocess->lock);
+}
+
+/* chart measurement as a structure (for the "measured" signal and the element message) */
+static GstStructure *
+gst_markerdetect_result_structure (const GstMarkerDetectResult *result)
+{
+  GstStructure *s = gst_structure_new("markerdetect", "chart", G_TYPE_INT, result->chart, NULL);
+
+  // chart quad : top left, top right, bottom right, bottom left (x,y)
+  const cv::Point2f quad[4] = { result->tl_xy, result->tr_xy, result->br_xy, result->bl_xy };
+  GValue corners = G_VALUE_INIT;
+  g_value_init (&corners, GST_TYPE_ARRAY);
+  for ( int k = 0; k < 4; k++ )
+  {
+    GValue v = G_VALUE_INIT;
+    g_value_init (&v, G_TYPE_DOUBLE);
+    g_value_set_double (&v, quad[k].x);
+    gst_value_array_append_value (&corners, &v);
+    g_value_set_double (&v, quad[k].y);
+    gst_value_array_append_and_take_value (&corners, &v);
+  }
+  gst_structure_take_value (s, "corners", &corners);
+
+  if ( result->chart == 1001 )
+  {
+    // 24 x B,G,R means, then the chart errors in each color space
+    GValue means = G_VALUE_INIT;
+    g_value_init (&means, GST_TYPE_ARRAY);
+    for ( int i = 0; i < 24; i++ )
+    {
+      for ( int c = 0; c < 3; c++ )
+      {
+        GValue v = G_VALUE_INIT;
+        g_value_init (&v, G_TYPE_DOUBLE);
+        g_value_set_double (&v, result->patchMeans[i][c]);
+        gst_value_array_append_and_take_value (&means, &v);
+      }
+    }
+    gst_structure_take_value (s, "means", &means);
+    gst_structure_set (s,
+        "error-bgr", G_TYPE_DOUBLE, (gdouble) result->chartErrors[0][0],
+        "error-uv", G_TYPE_DOUBLE, (gdouble) result->chartErrors[1][0],
+        "error-lab", G_TYPE_DOUBLE, (gdouble) result->chartErrors[2][0],
+        "error-hsv", G_TYPE_DOUBLE, (gdouble) result->chartErrors[3][0],
+        "error-xyz", G_TYPE_DOUBLE, (gdouble) result->chartErrors[4][0],
+        NULL);
+    if ( result->groupSize > 1 )
+    {
+      // patch deltas to the average of the cameras of the group
+      GValue deltas = G_VALUE_INIT;
+      double total = 0;
+      g_value_init (&deltas, GST_TYPE_ARRAY);
+      for ( int i = 0; i < 24; i++ )
+      {
+        GValue v = G_VALUE_INIT;
+        g_value_init (&v, G_TYPE_DOUBLE);
+        g_value_set_double (&v, result->groupDeltas[i]);
+        gst_value_array_append_and_take_value (&deltas, &v);
+        total += result->groupDeltas[i];
+      }
+      gst_structure_take_value (s, "group-deltas", &deltas);
+      gst_structure_set (s,
+          "group-size", G_TYPE_INT, result->groupSize,
+          "group-delta", G_TYPE_DOUBLE, total / 24,
+          NULL);
+    }
+  }
+  else if ( result->chart == 1002 )
+  {
+    gst_structure_set (s,
+        "b", G_TYPE_DOUBLE, result->wbMean[0],
+        "g", G_TYPE_DOUBLE, result->wbMean[1],
+        "r", G_TYPE_DOUBLE, result->wbMean[2],
+        NULL);
+  }
+  return s;
+}
+
+//
+// Camera groups (group property)
+//
+// The elements of a group share their latest Color Checker patch means, so
+// that each measurement of a camera can report how far each of its patches is
+// from the group average (cross-camera color consistency). A group is scoped
+// to the pipeline (top-level bin) of its elements : unrelated pipelines using
+// the same group name do not share their measurements.
+//
+
+typedef struct
+{
+  GstMarkerDetect *markerdetect;
+  const void *pipeline;                 /* top-level bin, only compared */
+  gint64 time;
+  float means[24][3];
+} GstMarkerDetectGroupMember;
+
+static GMutex groupLock;
+static std::map<std::string, std::vector<GstMarkerDetectGroupMember>> groups;
+
+/* remove the element from all groups (group lock held) */
+static void
+gst_markerdetect_group_remove (GstMarkerDetect *markerdetect, const std::string &except)
+{
+  for ( auto it = groups.begin(); it != groups.end(); )
+  {
+    auto &members = it->second;
+    if ( it->first != except )
+    {
+      members.erase(std::remove_if(members.begin(), members.end(),
+        [markerdetect](const GstMarkerDetectGroupMember &m) { return m.markerdetect == markerdetect; }), members.end());
+    }
+    if ( members.empty() )
+      it = groups.erase(it);
+    else
+      ++it;
+  }
+}
+
+/* top-level bin of the element (the element itself when it has no parent), as a group scope key */
+static const void *
+gst_markerdetect_group_pipeline (GstMarkerDetect *markerdetect)
+{
+  GstObject *top = GST_OBJECT (gst_object_ref (markerdetect));
+  GstObject *parent;
+  while ( (parent = gst_object_get_parent(top)) != NULL )
+  {
+    gst_object_unref (top);
+    top = parent;
+  }
+  gst_object_unref (top);
+  return top;
+}
+
+static void
+gst_markerdetect_group_leave (GstMarkerDetect *markerdetect)
+{
+  g_mutex_lock (&groupLock);
+  gst_markerdetect_group_remove(markerdetect, std::string());
+  g_mutex_unlock (&groupLock);
+}
+
+/* share the patch means of a Color Checker measurement, and compare them to the group average */
+static void
+gst_markerdetect_group_update (GstMarkerDetect *markerdetect, GstMarkerDetectResult *result)
+{
+  double average[24][3] = {};
+  int count = 0;
+
+  // (copied into the context's string : its storage is reused from frame to frame)
+  std::string &group = markerdetect->context->groupName;
+  GST_OBJECT_LOCK (markerdetect);
+  group.assign(markerdetect->group ? markerdetect->group : "");
+  GST_OBJECT_UNLOCK (markerdetect);
+  if ( group.empty() )
+    return;
+
+  const void *pipeline = gst_markerdetect_group_pipeline(markerdetect);
+  gint64 now = g_get_monotonic_time();
+  g_mutex_lock (&groupLock);
+  gst_markerdetect_group_remove(markerdetect, group);
+  // (the map entry and the member slot are only allocated when joining a group, never in the steady state)
+  auto &members = groups[group];
+  auto self = std::find_if(members.begin(), members.end(),
+    [markerdetect](const GstMarkerDetectGroupMember &m) { return m.markerdetect == markerdetect; });
+  if ( self == members.end() )
+  {
+    members.push_back(GstMarkerDetectGroupMember());
+    self = members.end() - 1;
+    self->markerdetect = markerdetect;
+  }
+  self->pipeline = pipeline;
+  self->time = now;
+  for ( int i = 0; i < 24; i++ )
+    for ( int c = 0; c < 3; c++ )
+      self->means[i][c] = result->patchMeans[i][c];
+
+  for ( const auto &member : members )
+  {
+    if ( (member.pipeline != pipeline) || ((now - member.time) > GST_MARKERDETECT_GROUP_MAX_AGE) )
+      continue;
+    for ( int i = 0; i < 24; i++ )
+      for ( int c = 0; c < 3; c++ )
+        average[i][c] += member.means[i][c];
+    count++;
+  }
+  g_mutex_unlock (&groupLock);
+
+  result->groupSize = count;
+  for ( int i = 0; i < 24; i++ )
+  {
+    double d2 = 0;
+    for ( int c = 0; c < 3; c++ )
+    {
+      double d = result->patchMeans[i][c] - average[i][c] / count;
+      d2 += d * d;
+    }
+    result->groupDeltas[i] = sqrt(d2);
+  }
+}
+
+/* publish a chart measurement : "measured" signal, element message, and script (if specified) */
+static void
+gst_markerdetect_publish (GstMarkerDetect *markerdetect, const GstMarkerDetectResult *result)
+{
+  bool signal = g_signal_has_handler_pending (markerdetect, gst_markerdetect_signals[SIGNAL_MEASURED], 0, FALSE);
+
+  if ( markerdetect->post_messages || signal )
+  {
+    GstStructure *s = gst_markerdetect_result_structure(result);
+    if ( signal )
+    {
+      g_signal_emit (markerdetect, gst_markerdetect_signals[SIGNAL_MEASURED], 0, s);
+    }
+    if ( markerdetect->post_messages )
+    {
+      gst_element_post_message (GST_ELEMENT (markerdetect), gst_message_new_element (GST_OBJECT (markerdetect), s));
+    }
+    else
+    {
+      gst_structure_free (s);
+    }
+  }
+
+  if ( (result->chart != 1001) && (result->chart != 1002) )
+    return;
+
+  // the scripts may be replaced (and freed) by set_property while this runs on
+  // the analysis thread : take copies under the object lock
+  GstMarkerDetectCoprocess *coprocess;
+  GThreadPool *pool;
+  gchar *script;
+  gchar *extra_args;
+  GST_OBJECT_LOCK (markerdetect);
+  if ( result->chart == 1001 )
+  {
+    coprocess = &markerdetect->context->ccCoprocess;
+    pool = markerdetect->context->ccScriptPool;
+    script = g_strdup (markerdetect->cc_script);
+    extra_args = g_strdup (markerdetect->cc_extra_args);
+  }
+  else
+  {
+    coprocess = &markerdetect->context->wbCoprocess;
+    pool = markerdetect->context->wbScriptPool;
+    script = g_strdup (markerdetect->wb_script);
+    extra_args = g_strdup (markerdetect->wb_extra_args);
+  }
+  GST_OBJECT_UNLOCK (markerdetect);
+  if ( script == NULL )
+  {
+    g_free (extra_args);
+    return;
+  }
+
+  int values[24*3];
+  int count;
+  if ( result->chart == 1001 )
+  {
+    for ( int i = 0; i < 24; i++ )
+    {
+      for ( int c = 0; c < 3; c++ )
+        values[i*3+c] = int(result->patchMeans[i][c]);
+    }
+    count = 24*3;
+  }
+  else
+  {
+    for ( int c = 0; c < 3; c++ )
+      values[c] = int(result->wbMean[c]);
+    count = 3;
+  }
+  // the script mode is the one the element was started with (the co-process threads only exist then)
+  if ( coprocess->thread != NULL )
+    gst_markerdetect_coprocess_send(coprocess, values, count);
+  else
+    gst_markerdetect_queue_script(markerdetect, pool, script, extra_args, values, count);
+  g_free (script);
+  g_free (extra_args);
+}
+
+/* luma of a pixel, read on the native planes (BGR : green, as a luma stand-in) */
+static inline int
+gst_markerdetect_luma_at (const GstMarkerDetectImage *img, int x, int y)
+{
+  switch ( img->format )
+  {
+  case GST_VIDEO_FORMAT_BGR:
+    return img->bgr.ptr<uchar>(y)[3*x + 1];
+  case GST_VIDEO_FORMAT_YUY2:
+    // YUYV pairs : Y of pixel x is byte 2x of the row
+    return img->chroma.ptr<uchar>(y)[2*x];
+  default:
+    return img->luma.ptr<uchar>(y)[x];
+  }
+}
+
+/* copy a marker list into a result, reusing its vectors : once they have held as many
+   markers, nothing is allocated */
+static void
+gst_markerdetect_copy_markers (const std::vector<int> &markerIds, const std::vector<std::vector<cv::Point2f>> &markerCorners,
+    GstMarkerDetectResult *result)
+{
+  result->markerIds.assign(markerIds.begin(), markerIds.end());
+  result->markerCorners.resize(markerCorners.size());
+  for ( unsigned i = 0; i < markerCorners.size(); i++ )
+    result->markerCorners[i].assign(markerCorners[i].begin(), markerCorners[i].end());
+}
+
+/* copy the chart geometry of a result (markers, chart, corners, homography, projected patches) */
+static void
+gst_markerdetect_copy_geometry (const GstMarkerDetectResult *src, GstMarkerDetectResult *dst)
+{
+  gst_markerdetect_copy_markers(src->markerIds, src->markerCorners, dst);
+  dst->chart = src->chart;
+  dst->tl_xy = src->tl_xy;
+  dst->tr_xy = src->tr_xy;
+  dst->bl_xy = src->bl_xy;
+  dst->br_xy = src->br_xy;
+  dst->homography = src->homography;
+  std::copy(src->chartCorners, src->chartCorners + 4, dst->chartCorners);
+  std::copy(&src->patchCorners[0][0], &src->patchCorners[0][0] + 24*4, &dst->patchCorners[0][0]);
+  std::copy(&src->halfPatchCorners[0][0], &src->halfPatchCorners[0][0] + 24*4, &dst->halfPatchCorners[0][0]);
+}
+
+/* keep the chart geometry of a detected frame for the next frames (detect-interval),
+   with luma samples inside its corner markers for the motion check */
+static void
+gst_markerdetect_save_geometry (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, const GstMarkerDetectResult *result)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  context->geometryAge = 0;
+  context->geometryValid = (markerdetect->detect_interval > 1) && (result->chart != 0);
+  if ( !context->geometryValid )
+    return;
+
+  gst_markerdetect_copy_geometry(result, &context->geometry);
+  context->geometryWidth = img->width;
+  context->geometryHeight = img->height;
+
+  // The markers are high contrast black and white cells : chart or camera motion
+  // shows up there first, so a sparse grid inside each of them is enough
+  const int n = GST_MARKERDETECT_MOTION_GRID;
+  context->motionPoints.clear();
+  context->motionRef.clear();
+  for ( unsigned i = 0; i < result->markerIds.size(); i++ )
+  {
+    if ( gst_markerdetect_marker_role(result->markerIds[i]) < 0 )
+      continue;
+    const std::vector<cv::Point2f> &c = result->markerCorners[i];
+    for ( int v = 0; v < n; v++ )
+    {
+      for ( int u = 0; u < n; u++ )
+      {
+        float fu = (u + 0.5f) / n;
+        float fv = (v + 0.5f) / n;
+        cv::Point2f top = c[0] + (c[1] - c[0]) * fu;
+        cv::Point2f bottom = c[3] + (c[2] - c[3]) * fu;
+        cv::Point2f p = top + (bottom - top) * fv;
+        int x = cvRound(p.x);
+        int y = cvRound(p.y);
+        if ( x < 0 || y < 0 || x >= img->width || y >= img->height )
+          continue;
+        context->motionPoints.push_back(cv::Point(x, y));
+        context->motionRef.push_back((uchar)gst_markerdetect_luma_at(img, x, y));
+      }
+    }
+  }
+  context->geometryValid = !context->motionPoints.empty();
+}
+
+/* can the saved chart geometry be reused for this frame ?
+   (detect-interval not expired, and no motion over the corner markers) */
+static bool
+gst_markerdetect_reuse_geometry (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  if ( !context->geometryValid ||
+       (context->geometryAge + 1 >= markerdetect->detect_interval) ||
+       (img->width != context->geometryWidth) || (img->height != context->geometryHeight) )
+    return false;
+
+  // Sparse sum of absolute differences against the detected frame
+  unsigned sad = 0;
+  for ( unsigned i = 0; i < context->motionPoints.size(); i++ )
+  {
+    const cv::Point &p = context->motionPoints[i];
+    sad += abs(gst_markerdetect_luma_at(img, p.x, p.y) - context->motionRef[i]);
+  }
+  double mad = (double)sad / context->motionPoints.size();
+  if ( mad > markerdetect->motion_threshold )
+  {
+    GST_LOG_OBJECT (markerdetect, "chart moved (mean absolute difference %.1f), re-detecting", mad);
+    return false;
+  }
+  return true;
+}
+
+/* detect the markers, identify the chart they frame, and project its reference geometry */
+static void
+gst_markerdetect_locate_chart (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, GstMarkerDetectResult *result,
+    GstMarkerDetectTiming *timing)
+{
+  GstClockTime t0;
+
+  //
+  // Detect ARUCO markers
+  //   ref : https://docs.opencv.org/master/d5/dae/tutorial_aruco_detection.html
+  //
+  t0 = gst_markerdetect_timing_start(timing);
+  gst_markerdetect_detect_markers(markerdetect, img);
+  gst_markerdetect_timing_stop(timing, GST_MARKERDETECT_STAGE_DETECT, t0);
+  std::vector<int> &markerIds = markerdetect->context->markerIds;
+  std::vector<std::vector<cv::Point2f>> &markerCorners = markerdetect->context->markerCorners;
+
+  gst_markerdetect_copy_markers(markerIds, markerCorners, result);
+  result->chart = 0;
+  
+  if (markerIds.size() >= 4 )
+  {
+    int tl_id = 0;
+    int tr_id = 0;
+    int bl_id = 0;
+    int br_id = 0;
+    cv::Point2f tl_xy, tr_xy, bl_xy, br_xy;
+    for ( unsigned i = 0; i < markerIds.size(); i++ )
+    {
+      switch ( markerIds[i] )
+      {
+      case 923:
+        tl_id = markerIds[i];
+        //tl_xy = markerCorners[i][2]; // bottom right corner of top left marker
+        tl_xy = markerCorners[i][3]; // bottom left corner of top left marker
+        break;
+      case 1001:
+      case 1002:
+      case 1003:
+      case 1004:
+      case 1005:
+      case 1006:
+        tr_id = markerIds[i];
+        //tr_xy = markerCorners[i][3]; // bottom left corner of top right marker
+        tr_xy = markerCorners[i][2]; // bottom right corner of top right marker
+        break;
+      case 1007:
+        bl_id = markerIds[i];
+        //bl_xy = markerCorners[i][1]; // top right corner of bottom left marker
+        bl_xy = markerCorners[i][0]; // top left corner of bottom left marker
+        break;
+      case 241:
+        br_id = markerIds[i];
+        //br_xy = markerCorners[i][0]; // top left corner of bottom right marker
+        br_xy = markerCorners[i][1]; // top right corner of bottom right marker
+        break;
+      default:
+        break;
+      }
+    }
+    result->tl_xy = tl_xy;
+    result->tr_xy = tr_xy;
+    result->bl_xy = bl_xy;
+    result->br_xy = br_xy;
+
+    // Calculate transformation matrix based on ROI defined by ArUco markers
+    // (all charts share the marker layout)
+    if ( (tl_id==923) && (tr_id!=0) && (bl_id==1007) && (br_id==241) )
+    {
+      t0 = gst_markerdetect_timing_start(timing);
+      const cv::Point2f dstPoints[4] = { tl_xy, tr_xy, br_xy, bl_xy };
+      result->homography = gst_markerdetect_homography(arucoCornersRef, dstPoints);
+      gst_markerdetect_timing_stop(timing, GST_MARKERDETECT_STAGE_HOMOGRAPHY, t0);
+    }
+
+    // Chart 1 - Color Checker CLASSIC
+    if ( (tl_id==923) && (tr_id==1001) && (bl_id==1007) && (br_id==241) )
+    {
+      result->chart = 1001;
+
+      const cv::Matx33d &H = result->homography;
+
+      // Calculate real coordinates for corners and color patches
+      t0 = gst_markerdetect_timing_start(timing);
+      for ( int k = 0; k < 4; k++ )
+      {
+        result->chartCorners[k] = gst_markerdetect_project(H, chartCornersRef[k].x, chartCornersRef[k].y);
+      }
+
+      for ( int i = 0; i < 24; i++ )
+      {
+        const cv::Point2f &c = chartCentroidsRef[i];
+        cv::Point2f *patchCorners = result->patchCorners[i];
+        cv::Point2f *halfPatchCorners = result->halfPatchCorners[i];
+
+        // Define corner points for each color patch
+        patchCorners[0] = gst_markerdetect_project(H, c.x-(colorPatchWidth/2), c.y-(colorPatchHeight/2));
+        patchCorners[1] = gst_markerdetect_project(H, c.x+(colorPatchWidth/2), c.y-(colorPatchHeight/2));
+        patchCorners[2] = gst_markerdetect_project(H, c.x+(colorPatchWidth/2), c.y+(colorPatchHeight/2));
+        patchCorners[3] = gst_markerdetect_project(H, c.x-(colorPatchWidth/2), c.y+(colorPatchHeight/2));
+
+        // Ground truth is overlaid on the right half of the color patch
+        halfPatchCorners[0] = gst_markerdetect_project(H, c.x                        , c.y-(colorPatchFullHeight/2));
+        halfPatchCorners[1] = gst_markerdetect_project(H, c.x+(colorPatchFullWidth/2), c.y-(colorPatchFullHeight/2));
+        halfPatchCorners[2] = gst_markerdetect_project(H, c.x+(colorPatchFullWidth/2), c.y+(colorPatchFullHeight/2));
+        halfPatchCorners[3] = gst_markerdetect_project(H, c.x                        , c.y+(colorPatchFullHeight/2));
+      }
+      gst_markerdetect_timing_stop(timing, GST_MARKERDETECT_STAGE_HOMOGRAPHY, t0);
+    }
+    // Chart 2 - White Reference
+    if ( (tl_id==923) && (tr_id==1002) && (bl_id==1007) && (br_id==241) )
+    {
+      result->chart = 1002;
+    }
+    // Chart 3 - Histogram
+    if ( (tl_id==923) && (tr_id==1003) && (bl_id==1007) && (br_id==241) )
+    {
+      result->chart = 1003;
+    }
+  }
+}
+
+/* detect the markers, and measure the chart they frame (no drawing) */
+static void
+gst_markerdetect_analyze (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, GstMarkerDetectResult *result)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  GstMarkerDetectTiming timing;
+  GstClockTime t0;
+
+  guint64 allocations = GST_MARKERDETECT_ALLOCATIONS();
+
+  gst_markerdetect_timing_init(markerdetect, &timing);
+  markerdetect->iterations++;
+  markerdetect->cc_frame_count++;
+  markerdetect->wb_frame_count++;
+
+  // Rebuild detector context only if detector properties changed
+  GST_OBJECT_LOCK (markerdetect);
+  if ( markerdetect->detector_dirty )
+  {
+    gst_markerdetect_build_context(markerdetect);
+  }
+  GST_OBJECT_UNLOCK (markerdetect);
+
+  // Chart geometry : reused from a previous frame while the markers do not move
+  // (detect-interval), otherwise detected
+  t0 = gst_markerdetect_timing_start(&timing);
+  bool reuse = gst_markerdetect_reuse_geometry(markerdetect, img);
+  gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_DETECT, t0);
+  if ( reuse )
+  {
+    gst_markerdetect_copy_geometry(&context->geometry, result);
+    context->geometryAge++;
+    // The markers did not move : the tracker is fed the reused corners (the detector's
+    // lists still hold them), so that its velocity decays to zero instead of going stale
+    if ( markerdetect->track && context->trackValid )
+    {
+      gst_markerdetect_update_track(markerdetect, false);
+    }
+  }
+  else
+  {
+    gst_markerdetect_locate_chart(markerdetect, img, result, &timing);
+    gst_markerdetect_save_geometry(markerdetect, img, result);
+  }
+  result->groupSize = 0;
+
+  const cv::Point2f &tl_xy = result->tl_xy;
+  const cv::Point2f &tr_xy = result->tr_xy;
+  const cv::Point2f &bl_xy = result->bl_xy;
+  const cv::Point2f &br_xy = result->br_xy;
+
+  // Chart 1 - Color Checker CLASSIC
+  if ( result->chart == 1001 )
+  {
+    //
+    // Calculate color gains
+    //   ref : https://stackoverflow.com/questions/32466616/finding-the-average-color-within-a-polygon-bound-in-opencv
+    //
+    // The patches are independent : they are sampled in parallel, each writing
+    // its own entries, and the color errors are then computed over all of them.
+    // Small patches are cheaper to sample than to dispatch : one stripe then.
+    //
+    double patchArea = 0.;
+    for ( int i = 0; i < 24; i++ )
+    {
+      const cv::Point2f *q = result->patchCorners[i];
+      patchArea += 0.5 * std::fabs((q[2] - q[0]).cross(q[3] - q[1]));
+    }
+    bool parallel = (patchArea >= GST_MARKERDETECT_PARALLEL_SAMPLING_AREA);
+    t0 = gst_markerdetect_timing_start(&timing);
+    cv::parallel_for_(cv::Range(0, 24), [&](const cv::Range &range) {
+      GstMarkerDetectContext *context = markerdetect->context;
+      for ( int i = range.start; i < range.end; i++ )
+      {
+        const cv::Point2f *patchCorners = result->patchCorners[i];
+
+        // Color patch polygon
+        cv::Point pts[1][4];
+        pts[0][0] = cv::Point(patchCorners[0].x,patchCorners[0].y);
+        pts[0][1] = cv::Point(patchCorners[1].x,patchCorners[1].y);
+        pts[0][2] = cv::Point(patchCorners[2].x,patchCorners[2].y);
+        pts[0][3] = cv::Point(patchCorners[3].x,patchCorners[3].y);
+
+        // Calculate mean in polygon area
+        cv::Scalar bgr_mean1 = gst_markerdetect_quad_mean( markerdetect, img, pts[0] );
+        float b_mean = bgr_mean1(0);
+        float g_mean = bgr_mean1(1);
+        float r_mean = bgr_mean1(2);
+        result->patchMeans[i] = bgr_mean1;
+        context->patchBGR(i,0) = cv::Vec3f(b_mean, g_mean, r_mean);
+      }
+    }, parallel ? -1. : 1.);
+    gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_SAMPLING, t0);
+
+    // Chart errors (total, then per component) for each color space
+    t0 = gst_markerdetect_timing_start(&timing);
+    gst_markerdetect_chart_errors(markerdetect, result);
+    gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_COLOR, t0);
+
+    // Color consistency across the cameras of the group
+    gst_markerdetect_group_update(markerdetect, result);
+
+    // Publish measurement (signal, bus message, Color Checker script)
+    if ( (markerdetect->iterations > 50) && (markerdetect->cc_frame_count > markerdetect->cc_skip_frames) )
+    {
+      t0 = gst_markerdetect_timing_start(&timing);
+      gst_markerdetect_publish(markerdetect, result);
+      gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_PUBLISH, t0);
+      markerdetect->cc_frame_count = 0;
+    }
+  }
+
+  // Chart 2 - White Reference
+  if ( result->chart == 1002 )
+  {
+    //
+    // Calculate color gains
+    //   ref : https://stackoverflow.com/questions/32466616/finding-the-average-color-within-a-polygon-bound-in-opencv
+    //
+    cv::Point pts[1][4];
+    pts[0][0] = cv::Point(tl_xy.x,tl_xy.y);
+    pts[0][1] = cv::Point(tr_xy.x,tr_xy.y);
+    pts[0][2] = cv::Point(br_xy.x,br_xy.y);
+    pts[0][3] = cv::Point(bl_xy.x,bl_xy.y);
+    // Calculate mean in polygon area
+    t0 = gst_markerdetect_timing_start(&timing);
+    auto bgr_mean = gst_markerdetect_quad_mean( markerdetect, img, pts[0] );
+    gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_SAMPLING, t0);
+    result->wbMean = bgr_mean;
+    // Find the gain of a channel
+    //double K = (b_mean+g_mean+r_mean)/3;
+    //double Kb = K/b_mean;
+    //double Kg = K/g_mean;
+    //double Kr = K/r_mean;
+    //printf( "Stats : B=%5.3f G=%5.3f R=%5.3f > Kb=%5.3f Kg=%5.3f Kr=%5.3f\n", b_mean, g_mean, r_mean, Kb, Kg, Kr );
+    
+    // Publish measurement (signal, bus message, White Balance script)
+    if ( (markerdetect->iterations > 50) && (markerdetect->wb_frame_count > markerdetect->wb_skip_frames) )
+    {
+      t0 = gst_markerdetect_timing_start(&timing);
+      gst_markerdetect_publish(markerdetect, result);
+      gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_PUBLISH, t0);
+      markerdetect->wb_frame_count = 0;
+    }
+  }
+
+  // Chart 3 - Histogram
+  if ( result->chart == 1003 )
+  {
+    cv::Point pts[1][4];
+    pts[0][0] = cv::Point(tl_xy.x,tl_xy.y);
+    pts[0][1] = cv::Point(tr_xy.x,tr_xy.y);
+    pts[0][2] = cv::Point(br_xy.x,br_xy.y);
+    pts[0][3] = cv::Point(bl_xy.x,bl_xy.y);
+
+    //
+    // Calculate color histograms
+    //    https://github.com/opencv/opencv/blob/3.4/samples/cpp/tutorial_code/Histograms_Matching/calcHist_Demo.cpp
+    //
+    // B,G,R histograms for BGR frames, Y,U,V (or Y only) for the native YUV/GRAY formats
+    t0 = gst_markerdetect_timing_start(&timing);
+    result->histCount = gst_markerdetect_quad_histograms( markerdetect, img, pts[0], result->hist );
+    gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_SAMPLING, t0);
+  }
+
+  timing.chart = (result->chart != 0);
+  gst_markerdetect_check_allocations(markerdetect, &timing, GST_MARKERDETECT_ALLOCATIONS() - allocations, "analyzing");
+  gst_markerdetect_timing_commit(markerdetect, &timing);
+}
+
+/* overlay an analysis result on the frame */
+static void
+gst_markerdetect_draw_result (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img, const GstMarkerDetectResult *result)
+{
+  if ( result->markerIds.size() > 0 )
+  {
+    gst_markerdetect_draw_markers(markerdetect, img, result->markerCorners, result->markerIds);
+  }
+  if ( markerdetect->overlay == GST_MARKERDETECT_OVERLAY_MARKERS )
+    return;
+
+  const cv::Point2f &tl_xy = result->tl_xy;
+  const cv::Point2f &tr_xy = result->tr_xy;
+  const cv::Point2f &bl_xy = result->bl_xy;
+  const cv::Point2f &br_xy = result->br_xy;
+
+  // fresh values as soon as a Color Checker shows up again
+  if ( result->chart != 1001 )
+    markerdetect->context->textLatched = false;
+
+  // Chart 1 - Color Checker CLASSIC
+  if ( result->chart == 1001 )
+  {
+    GstMarkerDetectContext *context = markerdetect->context;
+    unsigned colormap_size = G_N_ELEMENTS(colormap_GrYlRd);
+    //printf("[INFO] colormap_size = %d\n\r",colormap_size);
+
+    // Values shown : latched every overlay-refresh-interval frames (and as soon as the chart shows up)
+    GstMarkerDetectTextKey &values = context->textValues;
+    if ( !context->textLatched || (++context->textAge >= markerdetect->overlay_refresh_interval) )
+    {
+      for ( int i = 0; i < 24; i++ )
+        values.patchErrors[i] = unsigned(result->patchErrorYUV[i]);
+      for ( int s = 0; s < 5; s++ )
+        for ( int c = 0; c < 4; c++ )
+          values.chartErrors[s][c] = unsigned(result->chartErrors[s][c]);
+      context->textLatched = true;
+      context->textAge = 0;
+    }
+    GstMarkerDetectTextKey key = values;
+    key.showErrors = markerdetect->cc_show_ec;
+    key.deltaE = markerdetect->delta_e;
+
+    for ( int i = 0; i < 24; i++ )
+    {
+      const cv::Point2f *patchCorners = result->patchCorners[i];
+      const cv::Point patchCornersFixpt[4] = {
+        cv::Point(patchCorners[0].x,patchCorners[0].y), cv::Point(patchCorners[1].x,patchCorners[1].y),
+        cv::Point(patchCorners[2].x,patchCorners[2].y), cv::Point(patchCorners[3].x,patchCorners[3].y)
+      };
+      if ( markerdetect->cc_show_gt == TRUE )
+      {
+        // Overlay ground truth on right half of color patch (for visual comparison)
+        const cv::Point2f *halfPatchCorners = result->halfPatchCorners[i];
+        const cv::Point halfPatchCornersFixpt[4] = {
+          cv::Point(halfPatchCorners[0].x,halfPatchCorners[0].y), cv::Point(halfPatchCorners[1].x,halfPatchCorners[1].y),
+          cv::Point(halfPatchCorners[2].x,halfPatchCorners[2].y), cv::Point(halfPatchCorners[3].x,halfPatchCorners[3].y)
+        };
+        gst_markerdetect_draw_polygon(markerdetect, img, halfPatchCornersFixpt, 4, chartColorsRef[i], cv::FILLED);
+      }
+      if ( markerdetect->cc_show_ec == TRUE )
+      {
+        // Overlay correctness score in ROI region (the score itself is in the text layer)
+        unsigned colormap_index = values.patchErrors[i];
+        if (colormap_index >= colormap_size) colormap_index = colormap_size-1;
+        gst_markerdetect_draw_polygon(markerdetect, img, patchCornersFixpt, 4, colormap_GrYlRd[colormap_index], cv::FILLED);
+      }
+      else
+      {
+        // Draw Color Patch ROI
+        gst_markerdetect_draw_polygon(markerdetect, img, patchCornersFixpt, 4, cv::Scalar (163, 0, 255), 2);
+      }
+    }
+
+    // Labels : re-rendered only when the values shown or the settings change,
+    // and placed at the current pose on every frame
+    if ( !context->textValid || (memcmp(&key, &context->textKey, sizeof(key)) != 0) )
+    {
+      gst_markerdetect_layer_chart_text(markerdetect, &key);
+      context->textKey = key;
+      context->textValid = true;
+    }
+    gst_markerdetect_layer_chart_blit(markerdetect, img, result, key.showErrors);
+
+    // Draw border around "color checker" area
+    const cv::Point polygonPoints[4] = {
+      cv::Point(result->chartCorners[0].x,result->chartCorners[0].y), cv::Point(result->chartCorners[1].x,result->chartCorners[1].y),
+      cv::Point(result->chartCorners[2].x,result->chartCorners[2].y), cv::Point(result->chartCorners[3].x,result->chartCorners[3].y)
+    };
+    gst_markerdetect_draw_polygon(markerdetect, img, polygonPoints, 4, cv::Scalar (0, 255, 0), 2);
+    //for ( int i = 0; i < 24; i++ ) {
+    //    cv::circle(img, chartCentroids[i] ,5, cv::Scalar(163, 0, 255),cv::FILLED, 8,0);
+    //};
+  }
+
+  // Chart 2 - White Reference
+  if ( result->chart == 1002 )
+  {
+    // Extract ROI (area, ideally within 4 markers)
+    const cv::Point polygonPoints[4] = {
+      cv::Point(tl_xy.x,tl_xy.y), cv::Point(tr_xy.x,tr_xy.y), cv::Point(br_xy.x,br_xy.y), cv::Point(bl_xy.x,bl_xy.y)
+    };
+    double b_mean = result->wbMean(0);
+    double g_mean = result->wbMean(1);
+    double r_mean = result->wbMean(2);
+
+    // Draw bars 
+    int plot_w = 100, plot_h = 100;
+    cv::Mat &plotImage = markerdetect->context->plotImage;
+    plotImage.create( plot_h, plot_w, CV_8UC3 );
+    plotImage.setTo( cv::Scalar(255,255,255) );
+    int b_bar = int((b_mean/256.0)*80.0);
+    int g_bar = int((g_mean/256.0)*80.0);
+    int r_bar = int((r_mean/256.0)*80.0);
+    // layout of bars : |<-10->|<---20-->|<-10->|<---20-->|<-10->|<---20-->|<-10->|
+    cv::rectangle(plotImage, cv::Rect(10,(80-b_bar),20,b_bar), cv::Scalar(255, 0, 0), cv::FILLED, cv::LINE_8);
+    cv::rectangle(plotImage, cv::Rect(40,(80-g_bar),20,g_bar), cv::Scalar(0, 255, 0), cv::FILLED, cv::LINE_8);
+    cv::rectangle(plotImage, cv::Rect(70,(80-r_bar),20,r_bar), cv::Scalar(0, 0, 255), cv::FILLED, cv::LINE_8);
+    //printf( "Stats : BGR=%5.3f,%5.3f,%5.3f (%d,%d,%d) => Kbgr=%5.3f,%5.3f,%5.3f\n", b_mean, g_mean, r_mean, b_bar, g_bar, r_bar, Kb, Kg, Kr );
+    cv::putText(plotImage, gst_markerdetect_label(markerdetect, "%d", int(b_mean)), cv::Point(10,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(255,0,0), 1, cv::LINE_AA);
+    cv::putText(plotImage, gst_markerdetect_label(markerdetect, "%d", int(g_mean)), cv::Point(40,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(0,255,0), 1, cv::LINE_AA);
+    cv::putText(plotImage, gst_markerdetect_label(markerdetect, "%d", int(r_mean)), cv::Point(70,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(0,0,255), 1, cv::LINE_AA);
+
+    // Warp plot image onto video frame
+    const cv::Point2f dstPoints[4] = { tl_xy, tr_xy, br_xy, bl_xy };
+    gst_markerdetect_draw_image(markerdetect, img, plotImage, dstPoints);
+
+    // Draw border around "white reference" area
+    gst_markerdetect_draw_polygon(markerdetect, img, polygonPoints, 4, cv::Scalar (0, 255, 0), 2);
+  }
+
+  // Chart 3 - Histogram
+  if ( result->chart == 1003 )
+  {
+    // Extract ROI (area, ideally within 4 markers)
+    const cv::Point polygonPoints[4] = {
+      cv::Point(tl_xy.x,tl_xy.y), cv::Point(tr_xy.x,tr_xy.y), cv::Point(br_xy.x,br_xy.y), cv::Point(bl_xy.x,bl_xy.y)
+    };
+
+    int hist_w = 512, hist_h = 400;
+    cv::Mat &histImage = markerdetect->context->histImage;
+    histImage.create( hist_h, hist_w, CV_8UC3 );
+    histImage.setTo( cv::Scalar( 0,0,0) );
+    int histSize = 256; // number of bins
+    int bin_w = cvRound( (double) hist_w/histSize );
+    cv::Scalar histColors[3] = { cv::Scalar( 255, 0, 0), cv::Scalar( 0, 255, 0), cv::Scalar( 0, 0, 255) };
+    if ( img->format != GST_VIDEO_FORMAT_BGR )
+    {
+      histColors[0] = cv::Scalar( 255, 255, 255);
+      histColors[1] = cv::Scalar( 255, 0, 0);
+      histColors[2] = cv::Scalar( 0, 0, 255);
+    }
+    // Draw the histograms
+    for ( int c = 0; c < result->histCount; c++ )
+    {
+      // Normalize the result to ( 0, histImage.rows )
+      cv::Mat &hist = markerdetect->context->histNorm;
+      cv::normalize(cv::Mat(histSize, 1, CV_32F, (void *)result->hist[c]), hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat() );
+      // Draw for each channel
+      for( int i = 1; i < histSize; i++ )
+      {
+          cv::line( histImage, 
+                cv::Point( bin_w*(i-1), hist_h - cvRound(hist.at<float>(i-1)) ),
+                cv::Point( bin_w*(i), hist_h - cvRound(hist.at<float>(i)) ),
+                histColors[c], 2, 8, 0  );
+      }
+    }
+
+    // Draw border around ROI used for color histogram
+    //cv::rectangle(img, roi, cv::Scalar (0, 255, 0), 2, cv::LINE_AA);
+
+    // Warp histogram image onto video frame
+    const cv::Point2f dstPoints[4] = { tl_xy, tr_xy, br_xy, bl_xy };
+    gst_markerdetect_draw_image(markerdetect, img, histImage, dstPoints);
+    
+    // Draw border around "histgramm" area
+    gst_markerdetect_draw_polygon(markerdetect, img, polygonPoints, 4, cv::Scalar (0, 255, 0), 2);
+  }
+}
+
+/* deep copy of the frame planes (for the analysis worker) */
+static void
+gst_markerdetect_copy_image (const GstMarkerDetectImage *src, GstMarkerDetectImage *dst)
+{
+  dst->format = src->format;
+  dst->width = src->width;
+  dst->height = src->height;
+  // copyTo only reallocates when the size or type changed
+  src->bgr.copyTo(dst->bgr);
+  src->luma.copyTo(dst->luma);
+  src->chroma.copyTo(dst->chroma);
+}
+
+/* analyze a queued frame, and make it the latest result */
+static void
+gst_markerdetect_run_job (GstMarkerDetect *markerdetect, GstMarkerDetectImage *job)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  gst_markerdetect_analyze(markerdetect, job, &context->workerResult);
+
+  g_mutex_lock (&context->jobLock);
+  std::swap(context->latestResult, context->workerResult);
+  context->resultSerial++;
+  context->freeJobs.push_back(job);
+  g_mutex_unlock (&context->jobLock);
+}
+
+/* analysis worker : analyze queued frames, publish the latest result */
+static gpointer
+gst_markerdetect_worker (gpointer data)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (data);
+  GstMarkerDetectContext *context = markerdetect->context;
+
+#ifdef __linux__
+  if ( markerdetect->worker_cpu >= 0 )
+  {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(markerdetect->worker_cpu, &cpuset);
+    if ( pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0 )
+    {
+      GST_WARNING_OBJECT (markerdetect, "could not pin analysis worker to cpu %d", markerdetect->worker_cpu);
+    }
+  }
+#endif
+
+  g_mutex_lock (&context->jobLock);
+  while ( true )
+  {
+    while ( !context->workerStop && context->jobQueue.empty() )
+    {
+      g_cond_wait (&context->jobCond, &context->jobLock);
+    }
+    if ( context->workerStop )
       break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+    GstMarkerDetectImage *job = context->jobQueue.front();
+    context->jobQueue.erase(context->jobQueue.begin());
+    g_mutex_unlock (&context->jobLock);
+
+    gst_markerdetect_run_job(markerdetect, job);
+
+    g_mutex_lock (&context->jobLock);
+  }
+  g_mutex_unlock (&context->jobLock);
+
+  return NULL;
+}
+
+//
+// Shared analysis pool (worker-pool=shared)
+//
+// One fixed-size pool of threads (one per core) serves the async analysis of
+// all the elements of the process, instead of one busy thread per element.
+// Each stream keeps its own drop-oldest job queue. Idle threads take the next
+// frame round-robin over the streams that have one queued and are not being
+// analyzed already (the analysis of a stream stays sequential), so that a
+// camera can not starve the others.
+//
+// Lock order : pool lock, then the jobLock of a stream.
+//
+
+typedef struct
+{
+  GMutex lock;                          /* static : zero initialized */
+  GCond cond;
+  GMutex lifecycle;                     /* serializes pool creation/destruction */
+  std::vector<GThread *> threads;
+  std::vector<GstMarkerDetect *> streams;
+  unsigned next;                        /* round-robin cursor */
+  bool stop;
+} GstMarkerDetectPool;
+
+static GstMarkerDetectPool sharedPool;
+
+/* next stream with a queued frame (pool lock held), marked as being analyzed */
+static GstMarkerDetect *
+gst_markerdetect_pool_next (GstMarkerDetectImage **job)
+{
+  unsigned count = sharedPool.streams.size();
+
+  for ( unsigned n = 0; n < count; n++ )
+  {
+    unsigned index = (sharedPool.next + n) % count;
+    GstMarkerDetect *markerdetect = sharedPool.streams[index];
+    GstMarkerDetectContext *context = markerdetect->context;
+    if ( context->analyzing )
+      continue;
+
+    g_mutex_lock (&context->jobLock);
+    *job = NULL;
+    if ( !context->jobQueue.empty() )
+    {
+      *job = context->jobQueue.front();
+      context->jobQueue.erase(context->jobQueue.begin());
+    }
+    g_mutex_unlock (&context->jobLock);
+
+    if ( *job != NULL )
+    {
+      context->analyzing = true;
+      sharedPool.next = index + 1;
+      return markerdetect;
+    }
+  }
+  return NULL;
+}
+
+static gpointer
+gst_markerdetect_pool_thread (gpointer data)
+{
+  GstMarkerDetect *markerdetect;
+  GstMarkerDetectImage *job;
+
+  g_mutex_lock (&sharedPool.lock);
+  while ( true )
+  {
+    while ( !sharedPool.stop && (markerdetect = gst_markerdetect_pool_next(&job)) == NULL )
+    {
+      g_cond_wait (&sharedPool.cond, &sharedPool.lock);
+    }
+    if ( sharedPool.stop )
       break;
+    g_mutex_unlock (&sharedPool.lock);
+
+    gst_markerdetect_run_job(markerdetect, job);
+
+    g_mutex_lock (&sharedPool.lock);
+    markerdetect->context->analyzing = false;
+    // the stream may have more frames queued, and its removal may be waiting
+    g_cond_broadcast (&sharedPool.cond);
+  }
+  g_mutex_unlock (&sharedPool.lock);
+
+  return NULL;
+}
+
+/* add a stream to the shared pool (starting the pool threads for the first one) */
+static void
+gst_markerdetect_pool_add (GstMarkerDetect *markerdetect)
+{
+  g_mutex_lock (&sharedPool.lifecycle);
+  if ( sharedPool.threads.empty() )
+  {
+    sharedPool.stop = false;
+    sharedPool.next = 0;
+    for ( guint i = 0; i < g_get_num_processors(); i++ )
+    {
+      sharedPool.threads.push_back(g_thread_new("markerdetect-pool", gst_markerdetect_pool_thread, NULL));
+    }
+    GST_INFO_OBJECT (markerdetect, "started shared analysis pool (%u threads)", (guint) sharedPool.threads.size());
+  }
+  g_mutex_lock (&sharedPool.lock);
+  sharedPool.streams.push_back(markerdetect);
+  g_mutex_unlock (&sharedPool.lock);
+  g_mutex_unlock (&sharedPool.lifecycle);
+}
+
+/* remove a stream from the shared pool, once its frame in analysis (if any) is done */
+static void
+gst_markerdetect_pool_remove (GstMarkerDetect *markerdetect)
+{
+  std::vector<GThread *> threads;
+
+  g_mutex_lock (&sharedPool.lifecycle);
+  g_mutex_lock (&sharedPool.lock);
+  sharedPool.streams.erase(std::remove(sharedPool.streams.begin(), sharedPool.streams.end(), markerdetect), sharedPool.streams.end());
+  while ( markerdetect->context->analyzing )
+  {
+    g_cond_wait (&sharedPool.cond, &sharedPool.lock);
+  }
+  if ( sharedPool.streams.empty() )
+  {
+    sharedPool.stop = true;
+    g_cond_broadcast (&sharedPool.cond);
+    threads.swap(sharedPool.threads);
+  }
+  g_mutex_unlock (&sharedPool.lock);
+
+  for ( unsigned i = 0; i < threads.size(); i++ )
+  {
+    g_thread_join (threads[i]);
+  }
+  g_mutex_unlock (&sharedPool.lifecycle);
+}
+
+/* start the analysis worker, with its pool of frame copies (queue-depth + the one being analyzed) */
+static void
+gst_markerdetect_start_worker (GstMarkerDetect *markerdetect)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  // both lists hold at most the whole pool : no reallocation while streaming
+  context->jobQueue.reserve(markerdetect->queue_depth + 1);
+  context->freeJobs.reserve(markerdetect->queue_depth + 1);
+  for ( int i = 0; i <= markerdetect->queue_depth; i++ )
+  {
+    context->freeJobs.push_back(new GstMarkerDetectImage());
+  }
+  context->workerStop = false;
+  context->resultSerial = 0;
+  context->drawnSerial = 0;
+  context->async = true;
+  if ( markerdetect->worker_pool == GST_MARKERDETECT_WORKER_POOL_SHARED )
+  {
+    context->pooled = true;
+    context->analyzing = false;
+    gst_markerdetect_pool_add(markerdetect);
+  }
+  else
+  {
+    context->worker = g_thread_new("markerdetect", gst_markerdetect_worker, markerdetect);
+  }
+}
+
+/* stop the analysis worker, dropping the frames still queued */
+static void
+gst_markerdetect_stop_worker (GstMarkerDetect *markerdetect)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+
+  if ( !context->async )
+    return;
+
+  if ( context->pooled )
+  {
+    gst_markerdetect_pool_remove(markerdetect);
+    context->pooled = false;
+  }
+  else
+  {
+    g_mutex_lock (&context->jobLock);
+    context->workerStop = true;
+    g_cond_signal (&context->jobCond);
+    g_mutex_unlock (&context->jobLock);
+    g_thread_join (context->worker);
+    context->worker = NULL;
+  }
+  context->async = false;
+
+  for ( unsigned i = 0; i < context->jobQueue.size(); i++ )
+    delete context->jobQueue[i];
+  for ( unsigned i = 0; i < context->freeJobs.size(); i++ )
+    delete context->freeJobs[i];
+  context->jobQueue.clear();
+  context->freeJobs.clear();
+}
+
+/* hand a copy of the frame to the analysis worker (dropping the oldest queued frame when full) */
+static void
+gst_markerdetect_queue_frame (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img)
+{
+  GstMarkerDetectContext *context = markerdetect->context;
+  GstMarkerDetectImage *job;
+
+  g_mutex_lock (&context->jobLock);
+  if ( !context->freeJobs.empty() )
+  {
+    job = context->freeJobs.back();
+    context->freeJobs.pop_back();
+  }
+  else
+  {
+    // the pool holds queue-depth + 1 frames, so the queue is full : drop the oldest
+    job = context->jobQueue.front();
+    context->jobQueue.erase(context->jobQueue.begin());
+    context->droppedFrames++;
+    GST_LOG_OBJECT (markerdetect, "analysis queue full, dropped oldest frame (%" G_GUINT64_FORMAT " dropped)", context->droppedFrames);
+  }
+  g_mutex_unlock (&context->jobLock);
+
+  gst_markerdetect_copy_image(img, job);
+
+  g_mutex_lock (&context->jobLock);
+  context->jobQueue.push_back(job);
+  g_cond_signal (&context->jobCond);
+  g_mutex_unlock (&context->jobLock);
+
+  if ( context->pooled )
+  {
+    g_mutex_lock (&sharedPool.lock);
+    g_cond_signal (&sharedPool.cond);
+    g_mutex_unlock (&sharedPool.lock);
+  }
+}
+
+/* passthrough keeps the input buffer, which may be shared (tee) : its metadata
+   is then made writable, for the meta, by a buffer copy that shares the memory */
+static GstFlowReturn
+gst_markerdetect_prepare_output_buffer (GstBaseTransform * trans, GstBuffer * input, GstBuffer ** outbuf)
+{
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (trans);
+
+  if ( gst_base_transform_is_passthrough(trans) && markerdetect->attach_meta && !gst_buffer_is_writable(input) )
+  {
+    *outbuf = gst_buffer_copy(input);
+    return (*outbuf != NULL) ? GST_FLOW_OK : GST_FLOW_ERROR;
   }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_markerdetect_parent_class)->prepare_output_buffer (trans, input, outbuf);
 }
 
-void
-gst_markerdetect_get_property (GObject * object, guint property_id,
-    GValue * value, GParamSpec * pspec)
+/* attach an analysis result to the buffer */
+static void
+gst_markerdetect_attach_meta (GstBuffer *buffer, const GstMarkerDetectResult *result)
 {
-  GstMarkerDetect *markerdetect = GST_MARKERDETECT (object);
+  GstMarkerDetectMeta *meta = gst_buffer_add_markerdetect_meta(buffer);
+  if ( meta == NULL )
+    return;
 
-  GST_DEBUG_OBJECT (markerdetect, "get_property");
+  meta->n_markers = MIN(result->markerIds.size(), GST_MARKERDETECT_META_MAX_MARKERS);
+  for ( unsigned i = 0; i < meta->n_markers; i++ )
+  {
+    meta->marker_ids[i] = result->markerIds[i];
+    for ( int k = 0; k < 4; k++ )
+    {
+      meta->marker_corners[i][k][0] = result->markerCorners[i][k].x;
+      meta->marker_corners[i][k][1] = result->markerCorners[i][k].y;
+    }
+  }
 
-  switch (property_id) {
-    case PROP_CC_SCRIPT:
-      g_value_set_string (value, markerdetect->cc_script);
-      break;
-    case PROP_CC_EXTRA_ARGS:
-      g_value_set_string (value, markerdetect->cc_extra_args);
-      break;
-    case PROP_CC_SKIP_FRAMES:
-      g_value_set_int (value, markerdetect->cc_skip_frames);
-      break;      
-    case PROP_CC_SHOW_GT:
-      g_value_set_boolean (value, markerdetect->cc_show_gt);
-      break;      
-    case PROP_CC_SHOW_EC:
-      g_value_set_boolean (value, markerdetect->cc_show_ec);
-      break;      
-    case PROP_WB_SCRIPT:
-      g_value_set_string (value, markerdetect->wb_script);
-      break;
-    case PROP_WB_EXTRA_ARGS:
-      g_value_set_string (value, markerdetect->wb_extra_args);
-      break;
-    case PROP_WB_SKIP_FRAMES:
-      g_value_set_int (value, markerdetect->wb_skip_frames);
-      break;      
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
-      break;
+  meta->chart = result->chart;
+  if ( result->chart == 0 )
+    return;
+  for ( int r = 0; r < 3; r++ )
+    for ( int c = 0; c < 3; c++ )
+      meta->homography[r][c] = result->homography(r,c);
+
+  if ( result->chart == 1001 )
+  {
+    for ( int i = 0; i < 24; i++ )
+    {
+      for ( int c = 0; c < 3; c++ )
+        meta->patch_means[i][c] = result->patchMeans[i][c];
+      meta->patch_errors[i] = result->patchErrorYUV[i];
+    }
+    memcpy(meta->chart_errors, result->chartErrors, sizeof(meta->chart_errors));
+  }
+  if ( result->chart == 1002 )
+  {
+    for ( int c = 0; c < 3; c++ )
+      meta->wb_mean[c] = result->wbMean[c];
+  }
+  if ( result->chart == 1003 )
+  {
+    meta->hist_count = result->histCount;
+    memcpy(meta->hist, result->hist, sizeof(meta->hist));
   }
 }
 
-void
-gst_markerdetect_dispose (GObject * object)
+//
+// Rectified chart output (chart_src)
+//
+// The chart region is warped into the chart reference frame (608x512, the
+// ArUco marker ROI shared by all charts), in the input format. The remap
+// tables only cover that output, and are rebuilt when the homography changes
+// (with detect-interval, only on re-detection), so each frame costs one
+// bilinear lookup per output pixel. YUY2 is remapped by YUYV pairs, so its
+// luma is output at half horizontal resolution.
+//
+
+/* remap tables of an output plane subsampled by (sx,sy) : plane pixel => chart reference point => frame plane
+   (the float table is built in the chart sized scratch) */
+static void
+gst_markerdetect_chart_map (const cv::Matx33d &H, cv::Size size, int sx, int sy, cv::Mat2f &scratch, cv::Mat &map1, cv::Mat &map2)
 {
-  GstMarkerDetect *markerdetect = GST_MARKERDETECT (object);
+  scratch.create(GST_MARKERDETECT_CHART_HEIGHT, GST_MARKERDETECT_CHART_WIDTH);
+  cv::Mat2f map = scratch(cv::Rect(0, 0, size.width, size.height));
 
-  GST_DEBUG_OBJECT (markerdetect, "dispose");
+  for ( int j = 0; j < size.height; j++ )
+  {
+    cv::Vec2f *m = map.ptr<cv::Vec2f>(j);
+    double v = (j + 0.5) * sy - 0.5;
+    for ( int i = 0; i < size.width; i++ )
+    {
+      double u = (i + 0.5) * sx - 0.5;
+      double w = H(2,0)*u + H(2,1)*v + H(2,2);
+      double x = (H(0,0)*u + H(0,1)*v + H(0,2)) / w;
+      double y = (H(1,0)*u + H(1,1)*v + H(1,2)) / w;
+      m[i] = cv::Vec2f((float)((x + 0.5) / sx - 0.5), (float)((y + 0.5) / sy - 0.5));
+    }
+  }
+  // fixed point tables : faster lookups
+  cv::convertMaps(map, cv::noArray(), map1, map2, CV_16SC2);
+}
 
-  /* clean up as possible.  may be called multiple times */
+/* (re)build the remap tables for a homography and format */
+static void
+gst_markerdetect_chart_maps (GstMarkerDetectContext *context, GstVideoFormat format, const cv::Matx33d &H)
+{
+  if ( context->chartMapValid && (context->chartMapFormat == format) && (context->chartMapH == H) )
+    return;
 
-  G_OBJECT_CLASS (gst_markerdetect_parent_class)->dispose (object);
+  cv::Size size(GST_MARKERDETECT_CHART_WIDTH, GST_MARKERDETECT_CHART_HEIGHT);
+  switch ( format )
+  {
+  case GST_VIDEO_FORMAT_NV12:
+    gst_markerdetect_chart_map(H, size, 1, 1, context->chartMapF, context->chartMap1, context->chartMap2);
+    gst_markerdetect_chart_map(H, cv::Size(size.width/2, size.height/2), 2, 2, context->chartMapF, context->chartSubMap1, context->chartSubMap2);
+    break;
+  case GST_VIDEO_FORMAT_YUY2:
+    gst_markerdetect_chart_map(H, cv::Size(size.width/2, size.height), 2, 1, context->chartMapF, context->chartSubMap1, context->chartSubMap2);
+    break;
+  default:
+    gst_markerdetect_chart_map(H, size, 1, 1, context->chartMapF, context->chartMap1, context->chartMap2);
+    break;
+  }
+  context->chartMapFormat = format;
+  context->chartMapH = H;
+  context->chartMapValid = true;
 }
 
-void
-gst_markerdetect_finalize (GObject * object)
+/* configure the chart pad : stream start, caps (input format and frame rate, chart reference size),
+   segment, and the buffer pool of its frames */
+static bool
+gst_markerdetect_chart_pad_setup (GstMarkerDetect *markerdetect, GstPad *pad)
 {
-  GstMarkerDetect *markerdetect = GST_MARKERDETECT (object);
+  GstMarkerDetectContext *context = markerdetect->context;
+  GstVideoInfo *in_info = &GST_VIDEO_FILTER (markerdetect)->in_info;
+  GstVideoInfo info;
 
-  GST_DEBUG_OBJECT (markerdetect, "finalize");
+  gst_video_info_set_format (&info, GST_VIDEO_INFO_FORMAT(in_info),
+    GST_MARKERDETECT_CHART_WIDTH, GST_MARKERDETECT_CHART_HEIGHT);
+  info.fps_n = in_info->fps_n;
+  info.fps_d = in_info->fps_d;
+  info.colorimetry = in_info->colorimetry;
+  GstCaps *caps = gst_video_info_to_caps (&info);
 
-  /* clean up object here */
+  gchar *stream_id = gst_pad_create_stream_id (pad, GST_ELEMENT (markerdetect), "chart");
+  gst_pad_push_event (pad, gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+  gst_pad_push_event (pad, gst_event_new_caps (caps));
+  gst_pad_push_event (pad, gst_event_new_segment (&GST_BASE_TRANSFORM (markerdetect)->segment));
 
-  G_OBJECT_CLASS (gst_markerdetect_parent_class)->finalize (object);
+  if ( context->chartPool != NULL )
+  {
+    gst_buffer_pool_set_active (context->chartPool, FALSE);
+    gst_object_unref (context->chartPool);
+  }
+  context->chartPool = gst_video_buffer_pool_new ();
+  GstStructure *config = gst_buffer_pool_get_config (context->chartPool);
+  gst_buffer_pool_config_set_params (config, caps, GST_VIDEO_INFO_SIZE(&info), 2, 0);
+  gst_buffer_pool_set_config (context->chartPool, config);
+  gst_caps_unref (caps);
+  context->chartInfo = info;
+
+  return gst_buffer_pool_set_active (context->chartPool, TRUE);
 }
 
-static gboolean
-gst_markerdetect_start (GstBaseTransform * trans)
+/* output the chart region of the frame, rectified, on the chart pad */
+static void
+gst_markerdetect_push_chart (GstMarkerDetect *markerdetect, GstMarkerDetectImage *img,
+    const GstMarkerDetectResult *result, GstBuffer *inbuf)
 {
-  GstMarkerDetect *markerdetect = GST_MARKERDETECT (trans);
+  GstMarkerDetectContext *context = markerdetect->context;
+  GstPad *pad = NULL;
+  bool pending = false;
 
-  GST_DEBUG_OBJECT (markerdetect, "start");
+  if ( result->chart == 0 )
+    return;
 
-  return TRUE;
+  GST_OBJECT_LOCK (markerdetect);
+  if ( markerdetect->chart_pad != NULL )
+  {
+    pad = GST_PAD (gst_object_ref (markerdetect->chart_pad));
+    pending = markerdetect->chart_pad_pending;
+    markerdetect->chart_pad_pending = FALSE;
+  }
+  GST_OBJECT_UNLOCK (markerdetect);
+  if ( pad == NULL )
+    return;
+
+  if ( pending && !gst_markerdetect_chart_pad_setup(markerdetect, pad) )
+  {
+    GST_WARNING_OBJECT (markerdetect, "could not configure the chart pad");
+    GST_OBJECT_LOCK (markerdetect);
+    markerdetect->chart_pad_pending = TRUE;
+    GST_OBJECT_UNLOCK (markerdetect);
+    gst_object_unref (pad);
+    return;
+  }
+
+  GstBuffer *outbuf = NULL;
+  GstVideoFrame outframe;
+  if ( gst_buffer_pool_acquire_buffer (context->chartPool, &outbuf, NULL) != GST_FLOW_OK )
+  {
+    gst_object_unref (pad);
+    return;
+  }
+  if ( !gst_video_frame_map (&outframe, &context->chartInfo, outbuf, GST_MAP_WRITE) )
+  {
+    gst_buffer_unref (outbuf);
+    gst_object_unref (pad);
+    return;
+  }
+
+  GstMarkerDetectImage chart;
+  gst_markerdetect_map_image(markerdetect, &outframe, &chart);
+  gst_markerdetect_chart_maps(context, img->format, result->homography);
+  switch ( img->format )
+  {
+  case GST_VIDEO_FORMAT_NV12:
+    cv::remap(img->luma, chart.luma, context->chartMap1, context->chartMap2, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    cv::remap(img->chroma, chart.chroma, context->chartSubMap1, context->chartSubMap2, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    break;
+  case GST_VIDEO_FORMAT_YUY2:
+    cv::remap(img->chroma, chart.chroma, context->chartSubMap1, context->chartSubMap2, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    break;
+  case GST_VIDEO_FORMAT_GRAY8:
+    cv::remap(img->luma, chart.luma, context->chartMap1, context->chartMap2, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    break;
+  case GST_VIDEO_FORMAT_BGR:
+  default:
+    cv::remap(img->bgr, chart.bgr, context->chartMap1, context->chartMap2, cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    break;
+  }
+  gst_video_frame_unmap (&outframe);
+
+  GST_BUFFER_PTS (outbuf) = GST_BUFFER_PTS (inbuf);
+  GST_BUFFER_DTS (outbuf) = GST_BUFFER_DTS (inbuf);
+  GST_BUFFER_DURATION (outbuf) = GST_BUFFER_DURATION (inbuf);
+  GstFlowReturn ret = gst_pad_push (pad, outbuf);
+  if ( (ret != GST_FLOW_OK) && (ret != GST_FLOW_NOT_LINKED) && (ret != GST_FLOW_FLUSHING) )
+  {
+    GST_WARNING_OBJECT (markerdetect, "chart pad push failed (%s)", gst_flow_get_name (ret));
+  }
+  gst_object_unref (pad);
 }
 
-static gboolean
-gst_markerdetect_stop (GstBaseTransform * trans)
+/* chart_src request pad (one at most) */
+static GstPad *
+gst_markerdetect_request_new_pad (GstElement * element, GstPadTemplate * templ,
+    const gchar * name, const GstCaps * caps)
 {
-  GstMarkerDetect *markerdetect = GST_MARKERDETECT (trans);
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (element);
+  GstPad *pad = gst_pad_new_from_template (templ, "chart_src");
 
-  GST_DEBUG_OBJECT (markerdetect, "stop");
+  gst_pad_use_fixed_caps (pad);
+  GST_OBJECT_LOCK (markerdetect);
+  if ( markerdetect->chart_pad != NULL )
+  {
+    GST_OBJECT_UNLOCK (markerdetect);
+    GST_WARNING_OBJECT (markerdetect, "chart_src pad already requested");
+    gst_object_unref (pad);
+    return NULL;
+  }
+  markerdetect->chart_pad = pad;
+  markerdetect->chart_pad_pending = TRUE;
+  GST_OBJECT_UNLOCK (markerdetect);
 
-  return TRUE;
+  // (activated by the element state change, or here when already running)
+  gst_element_add_pad (element, pad);
+  return pad;
 }
 
-static gboolean
-gst_markerdetect_set_info (GstVideoFilter * filter, GstCaps * incaps,
-    GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
+static void
+gst_markerdetect_release_pad (GstElement * element, GstPad * pad)
 {
-  GstMarkerDetect *markerdetect = GST_MARKERDETECT (filter);
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (element);
 
-  GST_DEBUG_OBJECT (markerdetect, "set_info");
+  GST_OBJECT_LOCK (markerdetect);
+  if ( markerdetect->chart_pad == pad )
+    markerdetect->chart_pad = NULL;
+  GST_OBJECT_UNLOCK (markerdetect);
 
-  return TRUE;
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
 }
 
-/* transform */
-static GstFlowReturn
-gst_markerdetect_transform_frame (GstVideoFilter * filter, GstVideoFrame * inframe,
-    GstVideoFrame * outframe)
+/* forward EOS and flushes to the chart pad, and resend its segment after a new one */
+static gboolean
+gst_markerdetect_sink_event (GstBaseTransform * trans, GstEvent * event)
 {
-  GstMarkerDetect *markerdetect = GST_MARKERDETECT (filter);
+  GstMarkerDetect *markerdetect = GST_MARKERDETECT (trans);
+  GstPad *pad = NULL;
 
-  GST_DEBUG_OBJECT (markerdetect, "transform_frame");
+  GST_OBJECT_LOCK (markerdetect);
+  if ( markerdetect->chart_pad != NULL )
+  {
+    pad = GST_PAD (gst_object_ref (markerdetect->chart_pad));
+    if ( GST_EVENT_TYPE (event) == GST_EVENT_SEGMENT )
+      markerdetect->chart_pad_pending = TRUE;
+  }
+  GST_OBJECT_UNLOCK (markerdetect);
 
-  return GST_FLOW_OK;
+  if ( pad != NULL )
+  {
+    switch ( GST_EVENT_TYPE (event) )
+    {
+    case GST_EVENT_EOS:
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_FLUSH_STOP:
+      gst_pad_push_event (pad, gst_event_ref (event));
+      break;
+    default:
+      break;
+    }
+    gst_object_unref (pad);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_markerdetect_parent_class)->sink_event (trans, event);
 }
 
 static GstFlowReturn
 gst_markerdetect_transform_frame_ip (GstVideoFilter * filter, GstVideoFrame * frame)
 {
   GstMarkerDetect *markerdetect = GST_MARKERDETECT (filter);
+  GstMarkerDetectContext *context = markerdetect->context;
+  GstMarkerDetectTiming timing;
+  // (the analysis checks its own allocations, on whichever thread runs it)
+  guint64 allocations = GST_MARKERDETECT_ALLOCATIONS();
 
-  markerdetect->iterations++;
-  markerdetect->cc_frame_count++;
-  markerdetect->wb_frame_count++;
+  gst_markerdetect_timing_init(markerdetect, &timing);
+  GstClockTime frameStart = gst_markerdetect_timing_start(&timing);
 
-  /* Setup an OpenCV Mat with the frame data */
-  int width = GST_VIDEO_FRAME_WIDTH(frame);
-  int height = GST_VIDEO_FRAME_HEIGHT(frame);
-  cv::Mat img(height, width, CV_8UC3, GST_VIDEO_FRAME_PLANE_DATA(frame, 0));
+  /* Setup OpenCV Mats with the frame data */
+  GstMarkerDetectImage img;
+  gst_markerdetect_map_image(markerdetect, frame, &img);
 
-  //
-  // Detect ARUCO markers
-  //   ref : https://docs.opencv.org/master/d5/dae/tutorial_aruco_detection.html
-  //
-  
-  std::vector<int> markerIds;
-  std::vector<std::vector<cv::Point2f>> markerCorners, rejectedCandidates;
-  cv::Ptr<cv::aruco::DetectorParameters> parameters = cv::aruco::DetectorParameters::create();
-  cv::Ptr<cv::aruco::Dictionary> dictionary = cv::aruco::getPredefinedDictionary(cv::aruco::DICT_ARUCO_ORIGINAL);
-  cv::aruco::detectMarkers(img, dictionary, markerCorners, markerIds, parameters, rejectedCandidates);
+  if ( context->async )
+  {
+    // Asynchronous : queue the frame for analysis, and overlay the latest completed result
+    gst_markerdetect_queue_frame(markerdetect, &img);
 
-  if ( markerIds.size() > 0 )
+    g_mutex_lock (&context->jobLock);
+    if ( context->drawnSerial != context->resultSerial )
+    {
+      // swapped, not copied : the worker's next result replaces the one handed back
+      std::swap(context->drawResult, context->latestResult);
+      context->drawnSerial = context->resultSerial;
+    }
+    g_mutex_unlock (&context->jobLock);
+  }
+  else
   {
-    cv::aruco::drawDetectedMarkers(img, markerCorners, markerIds);
+    guint64 analysisStart = GST_MARKERDETECT_ALLOCATIONS();
+    gst_markerdetect_analyze(markerdetect, &img, &context->drawResult);
+    allocations += GST_MARKERDETECT_ALLOCATIONS() - analysisStart;
   }
-  
-  if (markerIds.size() >= 4 )
+
+  // rectified chart, taken before the overlay is drawn
+  if ( markerdetect->chart_pad != NULL )
   {
-    int tl_id = 0;
-    int tr_id = 0;
-    int bl_id = 0;
-    int br_id = 0;
-    cv::Point2f tl_xy, tr_xy, bl_xy, br_xy;
-    for ( unsigned i = 0; i < markerIds.size(); i++ )
-    {
-      switch ( markerIds[i] )
-      {
-      case 923:
-        tl_id = markerIds[i];
-        //tl_xy = markerCorners[i][2]; // bottom right corner of top left marker
-        tl_xy = markerCorners[i][3]; // bottom left corner of top left marker
-        break;
-      case 1001:
-      case 1002:
-      case 1003:
-      case 1004:
-      case 1005:
-      case 1006:
-        tr_id = markerIds[i];
-        //tr_xy = markerCorners[i][3]; // bottom left corner of top right marker
-        tr_xy = markerCorners[i][2]; // bottom right corner of top right marker
-        break;
-      case 1007:
-        bl_id = markerIds[i];
-        //bl_xy = markerCorners[i][1]; // top right corner of bottom left marker
-        bl_xy = markerCorners[i][0]; // top left corner of bottom left marker
-        break;
-      case 241:
-        br_id = markerIds[i];
-        //br_xy = markerCorners[i][0]; // top left corner of bottom right marker
-        br_xy = markerCorners[i][1]; // top right corner of bottom right marker
-        break;
-      default:
-        break;
-      }
-    }
-    // Chart 1 - Color Checker CLASSIC
-    if ( (tl_id==923) && (tr_id==1001) && (bl_id==1007) && (br_id==241) )
-    {
-      // Reference coordinates manually taken from 608x512 image (ROI from ArUco markers)
-      std::vector<cv::Point2f> arucoCornersRef = {
-        {  0,  0}, {607,  0}, {607,511}, {  0,511}
-      };
-      std::vector<cv::Point2f> chartCornersRef = {
-        {  0, 57}, {607, 57}, {607,455}, {  0,455}
-      };
-      std::vector<cv::Point2f> chartCentroidsRef = {
-        { 46,103}, {150,103}, {252,103}, {355,103}, {458,103}, {561,103},
-        { 46,205}, {150,205}, {252,205}, {355,205}, {458,205}, {561,205},
-        { 46,307}, {150,307}, {252,307}, {355,307}, {458,307}, {561,307},
-        { 46,409}, {150,409}, {252,409}, {355,409}, {458,409}, {561,409}
-      };
-      // Reference width/height of color patches is approximately 89/88, so take safe subset of this
-      float colorPatchFullWidth = 88.0;
-      float colorPatchFullHeight = 88.0;
-      float colorPatchWidth = 50.0;
-      float colorPatchHeight = 50.0;
-      
-      // Ground Truth BGR values for 24 Color Patches
-      //std::vector<std::array<float, 3>> chartColorsRef =
-      std::vector<cv::Scalar> chartColorsRef =
-      { 
-      // Dark Skin      Light Skin     Blue Sky       Foliage        Blue Flower    Bluish Green   
-        { 68, 82,115}, {130,150,192}, {157,122, 98}, { 67,108, 87}, {177,128,133}, {170,189,103},
-      // Orange         Purple Red     Moderate Red   Purple         Yellow Green   Orange Yello
-        { 44,126,214}, {166, 91, 80}, { 99, 90,193}, {108, 60, 94}, { 64,188,157}, { 46,163,224},
-      // Blue           Green          Red            Yellow         Magenta        Cyan
-        {150, 61, 56}, { 73,148, 70}, { 60, 54,175}, { 31,199,231}, {149, 86,187}, {161,133,  8},
-      // White          Neutral 8      Neutral 65     Neutral 5      Neutral 35     Black
-        {242,243,243}, {200,200,200}, {160,160,160}, {121,122,122}, { 85, 85, 85}, { 52, 52, 52}
-      };
-      
-      // BGR values for GrYlRd colormap
-      // (generated with colormap_GrYlRd.py)
-      std::vector<cv::Scalar> colormap_GrYlRd =
-      {
-         {   58 ,  111 ,    4  },
-         {   62 ,  119 ,    8  },
-         {   66 ,  126 ,   12  },
-         {   71 ,  136 ,   17  },
-         {   75 ,  143 ,   21  },
-         {   79 ,  151 ,   25  },
-         {   82 ,  157 ,   36  },
-         {   86 ,  164 ,   51  },
-         {   89 ,  170 ,   63  },
-         {   92 ,  175 ,   75  },
-         {   95 ,  181 ,   87  },
-         {   99 ,  189 ,  102  },
-         {  100 ,  193 ,  112  },
-         {  101 ,  197 ,  122  },
-         {  102 ,  202 ,  132  },
-         {  103 ,  207 ,  144  },
-         {  104 ,  212 ,  154  },
-         {  105 ,  216 ,  164  },
-         {  111 ,  220 ,  175  },
-         {  117 ,  224 ,  183  },
-         {  122 ,  227 ,  191  },
-         {  127 ,  231 ,  199  },
-         {  133 ,  235 ,  209  },
-         {  139 ,  239 ,  217  },
-         {  147 ,  241 ,  222  },
-         {  155 ,  244 ,  228  },
-         {  165 ,  247 ,  236  },
-         {  173 ,  249 ,  242  },
-         {  181 ,  252 ,  248  },
-         {  189 ,  254 ,  254  },
-         {  181 ,  249 ,  254  },
-         {  173 ,  244 ,  254  },
-         {  165 ,  239 ,  254  },
-         {  155 ,  233 ,  254  },
-         {  147 ,  228 ,  254  },
-         {  139 ,  224 ,  254  },
-         {  132 ,  216 ,  253  },
-         {  124 ,  206 ,  253  },
-         {  117 ,  198 ,  253  },
-         {  110 ,  190 ,  253  },
-         {  104 ,  182 ,  253  },
-         {   96 ,  172 ,  252  },
-         {   91 ,  162 ,  251  },
-         {   86 ,  152 ,  250  },
-         {   82 ,  142 ,  248  },
-         {   76 ,  129 ,  246  },
-         {   71 ,  119 ,  245  },
-         {   67 ,  109 ,  244  },
-         {   61 ,   97 ,  238  },
-         {   57 ,   87 ,  233  },
-         {   52 ,   77 ,  229  },
-         {   48 ,   68 ,  224  },
-         {   42 ,   56 ,  218  },
-         {   38 ,   47 ,  214  },
-         {   38 ,   39 ,  206  },
-         {   38 ,   32 ,  198  },
-         {   38 ,   22 ,  188  },
-         {   38 ,   15 ,  180  },
-         {   38 ,    7 ,  172  },
-         {   38 ,    0 ,  165  }
-      };
-      unsigned colormap_size = colormap_GrYlRd.size();
-      //printf("[INFO] colormap_size = %d\n\r",colormap_size);
-      
-      // Calculate transformation matrix based on ROI defined by ArUco markers
-      std::vector<cv::Point2f> srcPoints;
-      std::vector<cv::Point2f> dstPoints;
-      srcPoints.push_back(arucoCornersRef[0]);
-      srcPoints.push_back(arucoCornersRef[1]);
-      srcPoints.push_back(arucoCornersRef[2]);
-      srcPoints.push_back(arucoCornersRef[3]);      
-      dstPoints.push_back(tl_xy);
-      dstPoints.push_back(tr_xy);
-      dstPoints.push_back(br_xy);
-      dstPoints.push_back(bl_xy);
-      cv::Mat warpMatrix = cv::getPerspectiveTransform(srcPoints, dstPoints);
-
-      // Calculate real coordinates for corners and color patch centroids      
-      std::vector<cv::Point2f> chartCorners;
-      std::vector<cv::Point2f> chartCentroids;
-      cv::perspectiveTransform(chartCornersRef, chartCorners, warpMatrix);
-      cv::perspectiveTransform(chartCentroidsRef, chartCentroids, warpMatrix);
-
-      std::vector<cv::Mat> bgr_planes;
-      cv::split( img, bgr_planes );
-
-      // Create string of bgr values for each color patch
-      std::stringstream color_patch_bgr_values;
-      color_patch_bgr_values << "";
-
-      // Cumulate color patch errors
-      float chartErrorBGR = 0.0;
-      float chartErrorB = 0.0;
-      float chartErrorG = 0.0;
-      float chartErrorR = 0.0;
-
-      // YUV Color Space
-      float chartErrorYUV = 0.0;
-      float chartErrorY = 0.0;
-      float chartErrorU = 0.0;
-      float chartErrorV = 0.0;
-
-      // LAB Color Space
-      float chartErrorLAB = 0.0;
-      float chartErrorL = 0.0;
-      float chartErrorA = 0.0;
-      float chartErrorBB = 0.0;
-
-      // HSV Color Space
-      float chartErrorHSV = 0.0;
-      float chartErrorH = 0.0;
-      float chartErrorS = 0.0;
-      float chartErrorVV = 0.0;
-
-      // XYZ Color Space
-      float chartErrorXYZ = 0.0;
-      float chartErrorX = 0.0;
-      float chartErrorYY = 0.0;
-      float chartErrorZ = 0.0;
-      
-      for ( int i = 0; i < 24; i++ )
-      {
-        // Define corner points for each color patch
-        std::vector<cv::Point2f> patchCornersRef;
-        std::vector<cv::Point2f> patchCorners;
-        patchCornersRef.push_back(cv::Point2f(chartCentroidsRef[i].x-(colorPatchWidth/2),chartCentroidsRef[i].y-(colorPatchHeight/2)));
-        patchCornersRef.push_back(cv::Point2f(chartCentroidsRef[i].x+(colorPatchWidth/2),chartCentroidsRef[i].y-(colorPatchHeight/2)));
-        patchCornersRef.push_back(cv::Point2f(chartCentroidsRef[i].x+(colorPatchWidth/2),chartCentroidsRef[i].y+(colorPatchHeight/2)));  
-        patchCornersRef.push_back(cv::Point2f(chartCentroidsRef[i].x-(colorPatchWidth/2),chartCentroidsRef[i].y+(colorPatchHeight/2))); 
-        cv::perspectiveTransform(patchCornersRef, patchCorners, warpMatrix);
-        
-        //
-        // Calculate color gains
-        //   ref : https://stackoverflow.com/questions/32466616/finding-the-average-color-within-a-polygon-bound-in-opencv
-        //
-
-        // Create mask for color patch
-        cv::Point pts[1][4];
-        pts[0][0] = cv::Point(patchCorners[0].x,patchCorners[0].y);
-        pts[0][1] = cv::Point(patchCorners[1].x,patchCorners[1].y);
-        pts[0][2] = cv::Point(patchCorners[2].x,patchCorners[2].y);
-        pts[0][3] = cv::Point(patchCorners[3].x,patchCorners[3].y);
-        const cv::Point* points[1] = {pts[0]};
-        cv::Mat1b mask(img.rows, img.cols, uchar(0));
-        int npoints = 4;
-        cv::fillPoly(mask, points, &npoints, 1, cv::Scalar(255));
-        
-        // Calculate mean in masked area
-        //auto bgr_mean = cv::mean( img, mask );
-        cv::Scalar bgr_mean1 = cv::mean( img, mask );
-        float b_mean = bgr_mean1(0);
-        float g_mean = bgr_mean1(1);
-        float r_mean = bgr_mean1(2);
-        float b_error = chartColorsRef[i][0]-b_mean;
-        float g_error = chartColorsRef[i][1]-g_mean;
-        float r_error = chartColorsRef[i][2]-r_mean;
-
-        // Create string of bgr values for each color patch
-        color_patch_bgr_values << int(b_mean) << " " << int(g_mean) << " " << int(r_mean) << " ";
-        
-        // Cumulate color patch errors
-        float patchErrorBGR = std::sqrt(pow(b_error,2) + pow(g_error,2) + pow(r_error,2));
-        chartErrorBGR += patchErrorBGR;
-        chartErrorB += abs(b_error);
-        chartErrorG += abs(g_error);
-        chartErrorR += abs(r_error);
-
-        // Explore different color spaces        
-        cv::Mat3f bgr_mean2(cv::Vec3f(b_mean, g_mean, r_mean));
-        cv::Mat3f bgr_patch(cv::Vec3f(chartColorsRef[i][0],chartColorsRef[i][1],chartColorsRef[i][2]));
-
-        // YUV Color Space
-        cv::Mat3f yuv_mean;
-        cv::Mat3f yuv_patch;
-        cv::cvtColor(bgr_mean2, yuv_mean, cv::COLOR_BGR2YUV);
-        cv::cvtColor(bgr_patch, yuv_patch, cv::COLOR_BGR2YUV);
-        cv::Vec3f yuv_mean_pixel = yuv_mean[0][0];
-        cv::Vec3f yuv_patch_pixel = yuv_patch[0][0];
-        float y_error = yuv_patch_pixel[0]-yuv_mean_pixel[0];
-        float u_error = yuv_patch_pixel[1]-yuv_mean_pixel[1];
-        float v_error = yuv_patch_pixel[2]-yuv_mean_pixel[2];        
-        // Cumulate color patch errors
-        //float patchErrorYUV = std::sqrt(pow(y_error,2) + pow(u_error,2) + pow(v_error,2));
-        float patchErrorYUV = std::sqrt(pow(u_error,2) + pow(v_error,2));
-        chartErrorYUV += patchErrorYUV;
-        chartErrorY += abs(y_error);
-        chartErrorU += abs(u_error);
-        chartErrorV += abs(v_error);
-
-        // LAB Color Space
-        cv::Mat3f lab_mean;
-        cv::Mat3f lab_patch;
-        cv::cvtColor(bgr_mean2, lab_mean, cv::COLOR_BGR2Lab);
-        cv::cvtColor(bgr_patch, lab_patch, cv::COLOR_BGR2Lab);
-        cv::Vec3f lab_mean_pixel = lab_mean[0][0];
-        cv::Vec3f lab_patch_pixel = lab_patch[0][0];
-        float l_error = lab_patch_pixel[0]-lab_mean_pixel[0];
-        float a_error = lab_patch_pixel[1]-lab_mean_pixel[1];
-        float bb_error = lab_patch_pixel[2]-lab_mean_pixel[2];        
-        // Cumulate color patch errors
-        float patchErrorLAB = std::sqrt(pow(l_error,2) + pow(a_error,2) + pow(bb_error,2));
-        chartErrorLAB += patchErrorLAB;
-        chartErrorL += abs(l_error);
-        chartErrorA += abs(a_error);
-        chartErrorBB += abs(bb_error);
-
-        // HSV Color Space
-        cv::Mat3f hsv_mean;
-        cv::Mat3f hsv_patch;
-        cv::cvtColor(bgr_mean2, hsv_mean, cv::COLOR_BGR2HSV);
-        cv::cvtColor(bgr_patch, hsv_patch, cv::COLOR_BGR2HSV);
-        cv::Vec3f hsv_mean_pixel = hsv_mean[0][0];
-        cv::Vec3f hsv_patch_pixel = hsv_patch[0][0];
-        float h_error = hsv_patch_pixel[0]-hsv_mean_pixel[0];
-        float s_error = hsv_patch_pixel[1]-hsv_mean_pixel[1];
-        float vv_error = hsv_patch_pixel[2]-hsv_mean_pixel[2];        
-        // Cumulate color patch errors
-        float patchErrorHSV = std::sqrt(pow(h_error,2) + pow(s_error,2) + pow(vv_error,2));
-        chartErrorHSV += patchErrorHSV;
-        chartErrorH += abs(h_error);
-        chartErrorS += abs(s_error);
-        chartErrorVV += abs(vv_error);
-
-        // XYZ Color Space
-        cv::Mat3f xyz_mean;
-        cv::Mat3f xyz_patch;
-        cv::cvtColor(bgr_mean2, xyz_mean, cv::COLOR_BGR2XYZ);
-        cv::cvtColor(bgr_patch, xyz_patch, cv::COLOR_BGR2XYZ);
-        cv::Vec3f xyz_mean_pixel = xyz_mean[0][0];
-        cv::Vec3f xyz_patch_pixel = xyz_patch[0][0];
-        float x_error = xyz_patch_pixel[0]-xyz_mean_pixel[0];
-        float yy_error = xyz_patch_pixel[1]-xyz_mean_pixel[1];
-        float z_error = xyz_patch_pixel[2]-xyz_mean_pixel[2];        
-        // Cumulate color patch errors
-        float patchErrorXYZ = std::sqrt(pow(x_error,2) + pow(yy_error,2) + pow(z_error,2));
-        chartErrorXYZ += patchErrorXYZ;
-        chartErrorX += abs(x_error);
-        chartErrorYY += abs(yy_error);
-        chartErrorZ += abs(z_error);
-      
-#if 0
-        //
-        // This all seemed like a good idea, but the graphs are too small to be of any use
-        //
-        
-        // Draw bars of deltas between measured and ground truth
-        int plot_w = 100, plot_h = 100;
-        cv::Mat plotImage( plot_h, plot_w, CV_8UC3, cv::Scalar(255,255,255) );
-  #if 0
-        // Use these lines to display BGR average values
-        float b_value = b_mean;
-        float g_value = g_mean;
-        float r_value = r_mean;
-  #else
-        // Use these lines to display BGR error (with ground truth)
-        float b_value = b_error;
-        float g_value = g_error;
-        float r_value = r_error;
-  #endif
-        int b_bar = int((abs(b_value)/256.0)*80.0);
-        int g_bar = int((abs(g_value)/256.0)*80.0);
-        int r_bar = int((abs(r_value)/256.0)*80.0);
-        // layout of bars : |<-10->|<---20-->|<-10->|<---20-->|<-10->|<---20-->|<-10->|
-        cv::rectangle(plotImage, cv::Rect(10,(80-b_bar),20,b_bar), cv::Scalar(255, 0, 0), cv::FILLED, cv::LINE_8);
-        cv::rectangle(plotImage, cv::Rect(40,(80-g_bar),20,g_bar), cv::Scalar(0, 255, 0), cv::FILLED, cv::LINE_8);
-        cv::rectangle(plotImage, cv::Rect(70,(80-r_bar),20,r_bar), cv::Scalar(0, 0, 255), cv::FILLED, cv::LINE_8);
-        //printf( "Stats : BGR=%5.3f,%5.3f,%5.3f (%d,%d,%d) => Kbgr=%5.3f,%5.3f,%5.3f\n", b_mean, g_mean, r_mean, b_bar, g_bar, r_bar, Kb, Kg, Kr );
-        std::stringstream b_str;
-        std::stringstream g_str;
-        std::stringstream r_str;
-        b_str << int(b_value);
-        g_str << int(g_value);
-        r_str << int(r_value);
-        cv::putText(plotImage, b_str.str(), cv::Point(10,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(255,0,0), 1, cv::LINE_AA);
-        cv::putText(plotImage, g_str.str(), cv::Point(40,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(0,255,0), 1, cv::LINE_AA);
-        cv::putText(plotImage, r_str.str(), cv::Point(70,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(0,0,255), 1, cv::LINE_AA);
-  
-        // Calculate transformation matrix
-        std::vector<cv::Point2f> srcPoints;
-        std::vector<cv::Point2f> dstPoints;
-        srcPoints.push_back(cv::Point(       0,       0)); // top left
-        srcPoints.push_back(cv::Point(plot_w-1,       0)); // top right
-        srcPoints.push_back(cv::Point(plot_w-1,plot_h-1)); // bottom right
-        srcPoints.push_back(cv::Point(       0,plot_h-1)); // bottom left
-        dstPoints.push_back(patchCorners[0]);
-        dstPoints.push_back(patchCorners[1]);
-        dstPoints.push_back(patchCorners[2]);
-        dstPoints.push_back(patchCorners[3]);
-        cv::Mat h = cv::findHomography(srcPoints,dstPoints);
-        // Warp plot image onto video frame
-        cv::Mat img_temp = img.clone();
-        cv::warpPerspective(plotImage, img_temp, h, img_temp.size());
-        cv::Point pts_dst[4];
-        for( int i = 0; i < 4; i++)
-        {
-          pts_dst[i] = dstPoints[i];
-        }
-        cv::fillConvexPoly(img, pts_dst, 4, cv::Scalar(0), cv::LINE_AA);
-        img = img + img_temp;
-#endif        
+    gst_markerdetect_push_chart(markerdetect, &img, &context->drawResult, frame->buffer);
+  }
 
-        if ( markerdetect->cc_show_gt == TRUE )
-        {
-          // Overlay ground truth on right half of color patch (for visual comparison)
-          std::vector<cv::Point2f> halfPatchCornersRef;
-          std::vector<cv::Point2f> halfPatchCorners;
-          halfPatchCornersRef.push_back(cv::Point2f(chartCentroidsRef[i].x                        ,chartCentroidsRef[i].y-(colorPatchFullHeight/2)));
-          halfPatchCornersRef.push_back(cv::Point2f(chartCentroidsRef[i].x+(colorPatchFullWidth/2),chartCentroidsRef[i].y-(colorPatchFullHeight/2)));
-          halfPatchCornersRef.push_back(cv::Point2f(chartCentroidsRef[i].x+(colorPatchFullWidth/2),chartCentroidsRef[i].y+(colorPatchFullHeight/2)));  
-          halfPatchCornersRef.push_back(cv::Point2f(chartCentroidsRef[i].x                        ,chartCentroidsRef[i].y+(colorPatchFullHeight/2))); 
-          cv::perspectiveTransform(halfPatchCornersRef, halfPatchCorners, warpMatrix);
-          std::vector<cv::Point> halfPatchCornersFixpt;
-          halfPatchCornersFixpt.push_back( cv::Point(halfPatchCorners[0].x,halfPatchCorners[0].y) );
-          halfPatchCornersFixpt.push_back( cv::Point(halfPatchCorners[1].x,halfPatchCorners[1].y) );
-          halfPatchCornersFixpt.push_back( cv::Point(halfPatchCorners[2].x,halfPatchCorners[2].y) );
-          halfPatchCornersFixpt.push_back( cv::Point(halfPatchCorners[3].x,halfPatchCorners[3].y) );
-          cv::fillPoly(img, halfPatchCornersFixpt, chartColorsRef[i]);        
-        }
-        if ( markerdetect->cc_show_ec == TRUE )
-        {
-          // Overlay correctness score in ROI region        
-          std::vector<cv::Point> patchCornersFixpt;
-          patchCornersFixpt.push_back( cv::Point(patchCorners[0].x,patchCorners[0].y) );
-          patchCornersFixpt.push_back( cv::Point(patchCorners[1].x,patchCorners[1].y) );
-          patchCornersFixpt.push_back( cv::Point(patchCorners[2].x,patchCorners[2].y) );
-          patchCornersFixpt.push_back( cv::Point(patchCorners[3].x,patchCorners[3].y) );
-          unsigned colormap_index = (unsigned)patchErrorYUV;
-          if (colormap_index >= colormap_size) colormap_index = colormap_size-1;
-          cv::fillPoly(img, patchCornersFixpt, colormap_GrYlRd[colormap_index]);
-          std::stringstream e_str;        
-          e_str << unsigned(patchErrorYUV);
-          cv::putText(img, e_str.str(), cv::Point(patchCornersFixpt[3].x+5,patchCornersFixpt[3].y-5), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-        }
-        else
-        {
-          // Draw Color Patch ROI
-          std::vector<cv::Point> patchCornersFixpt;
-          patchCornersFixpt.push_back( cv::Point(patchCorners[0].x,patchCorners[0].y) );
-          patchCornersFixpt.push_back( cv::Point(patchCorners[1].x,patchCorners[1].y) );
-          patchCornersFixpt.push_back( cv::Point(patchCorners[2].x,patchCorners[2].y) );
-          patchCornersFixpt.push_back( cv::Point(patchCorners[3].x,patchCorners[3].y) );
-          cv::polylines(img, patchCornersFixpt, true, cv::Scalar (163, 0, 255), 2, 16);
-          std::stringstream e_str;
-          //e_str << "E=" << unsigned(patchErrorBGR) << "|" << unsigned(patchErrorYUV);
-          //e_str << "E[BGR|YUV]=" << unsigned(patchErrorBGR) << "|" << unsigned(patchErrorYUV);
-          //e_str << " E[B]=" << int(b_error) << " E[G]=" << int(g_error)  << " E[R]=" << int(r_error); 
-          //e_str << unsigned(patchErrorBGR) << "|" << unsigned(patchErrorYUV);
-          e_str << "E[UV]" << unsigned(patchErrorYUV);
-          cv::putText(img, e_str.str(), patchCornersFixpt[0], cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);        
-          cv::putText(img, e_str.str(), patchCornersFixpt[3], cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255,255,255), 1, cv::LINE_AA);
-        }
-        
-      }
-      
-      // BGR color space
-      unsigned int y_offset = 20;
-      std::stringstream e_str, eb_str, eg_str, er_str;
-      e_str << "E[BGR]=" << unsigned(chartErrorBGR);
-      cv::putText(img, e_str.str(), cv::Point(10,y_offset+20), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(99,31,0), 1, cv::LINE_AA);
-      eb_str << " E[B]=" << unsigned(chartErrorB);
-      cv::putText(img, eb_str.str(), cv::Point(10,y_offset+40), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(255,0,0), 1, cv::LINE_AA);
-      eg_str << " E[G]=" << unsigned(chartErrorG);
-      cv::putText(img, eg_str.str(), cv::Point(10,y_offset+60), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,255,0), 1, cv::LINE_AA);
-      er_str << " E[R]=" << unsigned(chartErrorR);
-      cv::putText(img, er_str.str(), cv::Point(10,y_offset+80), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,255), 1, cv::LINE_AA);
-
-      // YUV color space
-      y_offset += 100;
-      std::stringstream eyuv_str, ey_str, eu_str, ev_str;
-      eyuv_str << "E[UV]=" << unsigned(chartErrorYUV);
-      cv::putText(img, eyuv_str.str(), cv::Point(10,y_offset+20), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(99,31,0), 1, cv::LINE_AA);
-      ey_str << " E[Y]=" << unsigned(chartErrorY);
-      cv::putText(img, ey_str.str(), cv::Point(10,y_offset+40), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      eu_str << " E[U]=" << unsigned(chartErrorU);
-      cv::putText(img, eu_str.str(), cv::Point(10,y_offset+60), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      ev_str << " E[V]=" << unsigned(chartErrorV);
-      cv::putText(img, ev_str.str(), cv::Point(10,y_offset+80), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-
-      // LAB color space
-      y_offset += 100;
-      std::stringstream elab_str, el_str, ea_str, ebb_str;
-      elab_str << "E[LAB]=" << unsigned(chartErrorLAB);
-      cv::putText(img, elab_str.str(), cv::Point(10,y_offset+20), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(99,31,0), 1, cv::LINE_AA);
-      el_str << " E[L]=" << unsigned(chartErrorL);
-      cv::putText(img, el_str.str(), cv::Point(10,y_offset+40), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      ea_str << " E[A]=" << unsigned(chartErrorA);
-      cv::putText(img, ea_str.str(), cv::Point(10,y_offset+60), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      ebb_str << " E[B]=" << unsigned(chartErrorBB);
-      cv::putText(img, ebb_str.str(), cv::Point(10,y_offset+80), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-
-      // HSV color space
-      y_offset += 100;
-      std::stringstream ehsv_str, eh_str, es_str, evv_str;
-      ehsv_str << "E[HSV]=" << unsigned(chartErrorHSV);
-      cv::putText(img, ehsv_str.str(), cv::Point(10,y_offset+20), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(99,31,0), 1, cv::LINE_AA);
-      eh_str << " E[H]=" << unsigned(chartErrorH);
-      cv::putText(img, eh_str.str(), cv::Point(10,y_offset+40), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      es_str << " E[S]=" << unsigned(chartErrorS);
-      cv::putText(img, es_str.str(), cv::Point(10,y_offset+60), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      evv_str << " E[V]=" << unsigned(chartErrorVV);
-      cv::putText(img, evv_str.str(), cv::Point(10,y_offset+80), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      
-      // XYZ color space
-      y_offset += 100;
-      std::stringstream exyz_str, ex_str, eyy_str, ez_str;
-      exyz_str << "E[XYZ]=" << unsigned(chartErrorXYZ);
-      cv::putText(img, exyz_str.str(), cv::Point(10,y_offset+20), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(99,31,0), 1, cv::LINE_AA);
-      ex_str << " E[X]=" << unsigned(chartErrorX);
-      cv::putText(img, ex_str.str(), cv::Point(10,y_offset+40), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      eyy_str << " E[Y]=" << unsigned(chartErrorYY);
-      cv::putText(img, eyy_str.str(), cv::Point(10,y_offset+60), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      ez_str << " E[Z]=" << unsigned(chartErrorZ);
-      cv::putText(img, ez_str.str(), cv::Point(10,y_offset+80), cv::FONT_HERSHEY_PLAIN, 1.0, cv::Scalar(0,0,0), 1, cv::LINE_AA);
-      
-      // Draw border around "color checker" area
-      std::vector<cv::Point> polygonPoints;
-      polygonPoints.push_back(cv::Point(chartCorners[0].x,chartCorners[0].y));
-      polygonPoints.push_back(cv::Point(chartCorners[1].x,chartCorners[1].y));
-      polygonPoints.push_back(cv::Point(chartCorners[2].x,chartCorners[2].y));
-      polygonPoints.push_back(cv::Point(chartCorners[3].x,chartCorners[3].y));
-      cv::polylines(img, polygonPoints, true, cv::Scalar (0, 255, 0), 2, 16);
-      //for ( int i = 0; i < 24; i++ ) {
-      //    cv::circle(img, chartCentroids[i] ,5, cv::Scalar(163, 0, 255),cv::FILLED, 8,0);
-      //};
-
-      // Call Color Checker Script (if specified)
-      if ( markerdetect->cc_script != NULL )
-      { 
-        if ( (markerdetect->iterations > 50) && (markerdetect->cc_frame_count > markerdetect->cc_skip_frames) )
-        {
-          char szCommand[1024];
-          if ( markerdetect->cc_extra_args != NULL )
-          {
-            sprintf(szCommand,"%s %s %s\n", markerdetect->cc_script, color_patch_bgr_values.str().c_str(), markerdetect->cc_extra_args );
-          }
-          else {
-            sprintf(szCommand,"%s %s\n", markerdetect->cc_script, color_patch_bgr_values.str().c_str() );
-          }
-          //printf(szCommand);
-          system(szCommand);
-          
-          markerdetect->cc_frame_count = 0;
-        }
-      }
+  // in passthrough (overlay=none), the frame is mapped read-only
+  if ( markerdetect->overlay != GST_MARKERDETECT_OVERLAY_NONE )
+  {
+    GstClockTime t0 = gst_markerdetect_timing_start(&timing);
+    gst_markerdetect_draw_result(markerdetect, &img, &context->drawResult);
+    gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_OVERLAY, t0);
+  }
 
-    }
-    // Chart 2 - White Reference
-    if ( (tl_id==923) && (tr_id==1002) && (bl_id==1007) && (br_id==241) )
-    {
-      // Extract ROI (area, ideally within 4 markers)
-      std::vector<cv::Point> polygonPoints;
-      polygonPoints.push_back(cv::Point(tl_xy.x,tl_xy.y));
-      polygonPoints.push_back(cv::Point(tr_xy.x,tr_xy.y));
-      polygonPoints.push_back(cv::Point(br_xy.x,br_xy.y));
-      polygonPoints.push_back(cv::Point(bl_xy.x,bl_xy.y));
-      std::vector<cv::Mat> bgr_planes;
-      cv::split( img, bgr_planes );
-
-      //
-      // Calculate color gains
-      //   ref : https://stackoverflow.com/questions/32466616/finding-the-average-color-within-a-polygon-bound-in-opencv
-      //
-      cv::Point pts[1][4];
-      pts[0][0] = cv::Point(tl_xy.x,tl_xy.y);
-      pts[0][1] = cv::Point(tr_xy.x,tr_xy.y);
-      pts[0][2] = cv::Point(br_xy.x,br_xy.y);
-      pts[0][3] = cv::Point(bl_xy.x,bl_xy.y);
-      const cv::Point* points[1] = {pts[0]};
-      int npoints = 4;
-      // Create the mask with the polygon
-      cv::Mat1b mask(img.rows, img.cols, uchar(0));
-      cv::fillPoly(mask, points, &npoints, 1, cv::Scalar(255));
-      // Calculate mean in masked area
-      auto bgr_mean = cv::mean( img, mask );
-      double b_mean = bgr_mean(0);
-      double g_mean = bgr_mean(1);
-      double r_mean = bgr_mean(2);
-      // Find the gain of a channel
-      //double K = (b_mean+g_mean+r_mean)/3;
-      //double Kb = K/b_mean;
-      //double Kg = K/g_mean;
-      //double Kr = K/r_mean;
-      //printf( "Stats : B=%5.3f G=%5.3f R=%5.3f > Kb=%5.3f Kg=%5.3f Kr=%5.3f\n", b_mean, g_mean, r_mean, Kb, Kg, Kr );
-      
-      // Draw bars 
-      int plot_w = 100, plot_h = 100;
-      cv::Mat plotImage( plot_h, plot_w, CV_8UC3, cv::Scalar(255,255,255) );
-      int b_bar = int((b_mean/256.0)*80.0);
-      int g_bar = int((g_mean/256.0)*80.0);
-      int r_bar = int((r_mean/256.0)*80.0);
-      // layout of bars : |<-10->|<---20-->|<-10->|<---20-->|<-10->|<---20-->|<-10->|
-      cv::rectangle(plotImage, cv::Rect(10,(80-b_bar),20,b_bar), cv::Scalar(255, 0, 0), cv::FILLED, cv::LINE_8);
-      cv::rectangle(plotImage, cv::Rect(40,(80-g_bar),20,g_bar), cv::Scalar(0, 255, 0), cv::FILLED, cv::LINE_8);
-      cv::rectangle(plotImage, cv::Rect(70,(80-r_bar),20,r_bar), cv::Scalar(0, 0, 255), cv::FILLED, cv::LINE_8);
-      //printf( "Stats : BGR=%5.3f,%5.3f,%5.3f (%d,%d,%d) => Kbgr=%5.3f,%5.3f,%5.3f\n", b_mean, g_mean, r_mean, b_bar, g_bar, r_bar, Kb, Kg, Kr );
-      std::stringstream b_str;
-      std::stringstream g_str;
-      std::stringstream r_str;
-      b_str << int(b_mean);
-      g_str << int(g_mean);
-      r_str << int(r_mean);
-      cv::putText(plotImage, b_str.str(), cv::Point(10,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(255,0,0), 1, cv::LINE_AA);
-      cv::putText(plotImage, g_str.str(), cv::Point(40,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(0,255,0), 1, cv::LINE_AA);
-      cv::putText(plotImage, r_str.str(), cv::Point(70,90), cv::FONT_HERSHEY_PLAIN, 0.75, cv::Scalar(0,0,255), 1, cv::LINE_AA);
-
-      // Calculate transformation matrix
-      std::vector<cv::Point2f> srcPoints;
-      std::vector<cv::Point2f> dstPoints;
-      srcPoints.push_back(cv::Point(       0,       0)); // top left
-      srcPoints.push_back(cv::Point(plot_w-1,       0)); // top right
-      srcPoints.push_back(cv::Point(plot_w-1,plot_h-1)); // bottom right
-      srcPoints.push_back(cv::Point(       0,plot_h-1)); // bottom left
-      dstPoints.push_back(tl_xy);
-      dstPoints.push_back(tr_xy);
-      dstPoints.push_back(br_xy);
-      dstPoints.push_back(bl_xy);
-      cv::Mat h = cv::findHomography(srcPoints,dstPoints);
-      // Warp plot image onto video frame
-      cv::Mat img_temp = img.clone();
-      cv::warpPerspective(plotImage, img_temp, h, img_temp.size());
-      cv::Point pts_dst[4];
-      for( int i = 0; i < 4; i++)
-      {
-        pts_dst[i] = dstPoints[i];
-      }
-      cv::fillConvexPoly(img, pts_dst, 4, cv::Scalar(0), cv::LINE_AA);
-      img = img + img_temp;
-
-      // Draw border around "white reference" area
-      cv::polylines(img, polygonPoints, true, cv::Scalar (0, 255, 0), 2, 16);
-      
-      // Call White Balance Script (if specified)
-      if ( markerdetect->wb_script != NULL )
-      { 
-        if ( (markerdetect->iterations > 50) && (markerdetect->wb_frame_count > markerdetect->wb_skip_frames) )
-        {
-          char szCommand[256];
-          if ( markerdetect->wb_extra_args != NULL )
-          {
-            sprintf(szCommand,"%s %d %d %d %s\n", markerdetect->wb_script, int(b_mean), int(g_mean), int(r_mean), markerdetect->wb_extra_args );
-          }
-          else {
-            sprintf(szCommand,"%s %d %d %d\n", markerdetect->wb_script, int(b_mean), int(g_mean), int(r_mean) );
-          }
-          //printf(szCommand);
-          system(szCommand);
-          
-          markerdetect->wb_frame_count = 0;
-        }
-      }
+  if ( markerdetect->attach_meta )
+  {
+    gst_markerdetect_attach_meta(frame->buffer, &context->drawResult);
+  }
 
-    }
+  gst_markerdetect_check_allocations(markerdetect, &timing, GST_MARKERDETECT_ALLOCATIONS() - allocations, "streaming");
 
-    // Chart 3 - Histogram
-    if ( (tl_id==923) && (tr_id==1003) && (bl_id==1007) && (br_id==241) )
-    {
-      // Extract ROI (area, ideally within 4 markers)
-      std::vector<cv::Point> polygonPoints;
-      polygonPoints.push_back(cv::Point(tl_xy.x,tl_xy.y));
-      polygonPoints.push_back(cv::Point(tr_xy.x,tr_xy.y));
-      polygonPoints.push_back(cv::Point(br_xy.x,br_xy.y));
-      polygonPoints.push_back(cv::Point(bl_xy.x,bl_xy.y));
-      std::vector<cv::Mat> bgr_planes;
-      cv::split( img, bgr_planes );
-
-      cv::Point pts[1][4];
-      pts[0][0] = cv::Point(tl_xy.x,tl_xy.y);
-      pts[0][1] = cv::Point(tr_xy.x,tr_xy.y);
-      pts[0][2] = cv::Point(br_xy.x,br_xy.y);
-      pts[0][3] = cv::Point(bl_xy.x,bl_xy.y);
-      const cv::Point* points[1] = {pts[0]};
-      int npoints = 4;
-      // Create the mask with the polygon
-      cv::Mat1b mask(img.rows, img.cols, uchar(0));
-      cv::fillPoly(mask, points, &npoints, 1, cv::Scalar(255));
-
-      //
-      // Calculate color histograms
-      //    https://github.com/opencv/opencv/blob/3.4/samples/cpp/tutorial_code/Histograms_Matching/calcHist_Demo.cpp
-      //
-      int hist_w = 512, hist_h = 400;
-      cv::Mat histImage( hist_h, hist_w, CV_8UC3, cv::Scalar( 0,0,0) );
-      int histSize = 256; // number of bins
-      int bin_w = cvRound( (double) hist_w/histSize );
-      float range[] = { 0, 256 }; // ranges for B,G,R (the upper boundary is exclusive)
-      const float* histRange = { range };
-      bool uniform = true, accumulate = false;
-      cv::Mat b_hist, g_hist, r_hist;
-      cv::calcHist( &bgr_planes[0], 1, 0, mask, b_hist, 1, &histSize, &histRange, uniform, accumulate );
-      cv::calcHist( &bgr_planes[1], 1, 0, mask, g_hist, 1, &histSize, &histRange, uniform, accumulate );
-      cv::calcHist( &bgr_planes[2], 1, 0, mask, r_hist, 1, &histSize, &histRange, uniform, accumulate );
-      // Draw the histograms for B, G and R
-      // Normalize the result to ( 0, histImage.rows )
-      cv::normalize(b_hist, b_hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-      cv::normalize(g_hist, g_hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-      cv::normalize(r_hist, r_hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-      // Draw for each channel
-      for( int i = 1; i < histSize; i++ )
-      {
-          cv::line( histImage, 
-                cv::Point( bin_w*(i-1), hist_h - cvRound(b_hist.at<float>(i-1)) ),
-                cv::Point( bin_w*(i), hist_h - cvRound(b_hist.at<float>(i)) ),
-                cv::Scalar( 255, 0, 0), 2, 8, 0  );
-          cv::line( histImage, 
-                cv::Point( bin_w*(i-1), hist_h - cvRound(g_hist.at<float>(i-1)) ),
-                cv::Point( bin_w*(i), hist_h - cvRound(g_hist.at<float>(i)) ),
-                cv::Scalar( 0, 255, 0), 2, 8, 0  );
-          cv::line( histImage,
-                cv::Point( bin_w*(i-1), hist_h - cvRound(r_hist.at<float>(i-1)) ),
-                cv::Point( bin_w*(i), hist_h - cvRound(r_hist.at<float>(i)) ),
-                cv::Scalar( 0, 0, 255), 2, 8, 0  );
-      }
+  if ( timing.enabled )
+  {
+    gst_markerdetect_timing_stop(&timing, GST_MARKERDETECT_STAGE_FRAME, frameStart);
+    gst_markerdetect_timing_commit(markerdetect, &timing);
 
-      // Draw border around ROI used for color histogram
-      //cv::rectangle(img, roi, cv::Scalar (0, 255, 0), 2, cv::LINE_AA);
-
-      // Calculate transformation matrix
-      std::vector<cv::Point2f> srcPoints;
-      std::vector<cv::Point2f> dstPoints;
-      srcPoints.push_back(cv::Point(       0,       0)); // top left
-      srcPoints.push_back(cv::Point(hist_w-1,       0)); // top right
-      srcPoints.push_back(cv::Point(hist_w-1,hist_h-1)); // bottom right
-      srcPoints.push_back(cv::Point(       0,hist_h-1)); // bottom left
-      dstPoints.push_back(tl_xy);
-      dstPoints.push_back(tr_xy);
-      dstPoints.push_back(br_xy);
-      dstPoints.push_back(bl_xy);
-      cv::Mat h = cv::findHomography(srcPoints,dstPoints);
-      // Warp histogram image onto video frame
-      cv::Mat img_temp = img.clone();
-      cv::warpPerspective(histImage, img_temp, h, img_temp.size());
-      cv::Point pts_dst[4];
-      for( int i = 0; i < 4; i++)
+    // periodic stats, on the bus (and in the debug log)
+    if ( (++context->statsFrames % markerdetect->stats_interval) == 0 )
+    {
+      GstStructure *s = gst_markerdetect_stats_structure(markerdetect);
+      if ( context->async )
       {
-        pts_dst[i] = dstPoints[i];
+        g_mutex_lock (&context->jobLock);
+        gst_structure_set(s, "dropped-frames", G_TYPE_UINT64, context->droppedFrames, NULL);
+        g_mutex_unlock (&context->jobLock);
       }
-      cv::fillConvexPoly(img, pts_dst, 4, cv::Scalar(0), cv::LINE_AA);
-      img = img + img_temp;
-      
-      // Draw border around "histgramm" area
-      cv::polylines(img, polygonPoints, true, cv::Scalar (0, 255, 0), 2, 16);
-      
+      GST_INFO_OBJECT (markerdetect, "%" GST_PTR_FORMAT, s);
+      gst_element_post_message (GST_ELEMENT (markerdetect), gst_message_new_element (GST_OBJECT (markerdetect), s));
     }
   }
 
@@ -1098,6 +4719,11 @@ gst_markerdetect_transform_frame_ip (GstVideoFilter * filter, GstVideoFrame * fr
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
+#ifdef MARKERDETECT_COUNT_ALLOCATIONS
+  // (not preloaded : nothing counted, and no heap-allocations in the stats)
+  gst_markerdetect_heap_allocations = (unsigned long long (*) (void)) dlsym(RTLD_DEFAULT, "markerdetect_heap_allocations");
+  cv::setNumThreads(0);
+#endif
 
   /* FIXME Remember to set the rank if it's an element that is meant
      to be autoplugged by decodebin. */
@@ -30,6 +30,8 @@ G_BEGIN_DECLS
 
 typedef struct _GstMarkerDetect GstMarkerDetect;
 typedef struct _GstMarkerDetectClass GstMarkerDetectClass;
+typedef struct _GstMarkerDetectContext GstMarkerDetectContext;
+typedef struct _GstMarkerDetectStats GstMarkerDetectStats;
 
 struct _GstMarkerDetect
 {
@@ -48,6 +50,62 @@ struct _GstMarkerDetect
   gchar *wb_extra_args;
   unsigned wb_skip_frames;
   unsigned wb_frame_count; 
+
+  /* ArUco detector settings (detector context is rebuilt when these change) */
+  int dictionary;
+  int adaptive_thresh_win_size_min;
+  int adaptive_thresh_win_size_max;
+  int adaptive_thresh_win_size_step;
+  double min_marker_perimeter_rate;
+  double max_marker_perimeter_rate;
+  int corner_refinement_method;
+  bool reduced_dictionary;
+  int detect_scale;
+  int detect_tiles;
+  bool track;
+  int track_reacquire_interval;
+  double track_padding;
+  unsigned detect_interval;
+  double motion_threshold;
+  bool presence_filter;
+  unsigned presence_scan_interval;
+  bool detector_dirty;
+
+  /* analysis worker (async mode) */
+  bool async;
+  int queue_depth;
+  int worker_cpu;
+  int worker_pool;
+
+  /* camera group, for cross-camera color consistency */
+  gchar *group;
+
+  /* color difference for the Lab error (cie76, ciede2000) */
+  int delta_e;
+
+  /* post chart measurements as element messages */
+  bool post_messages;
+
+  /* how cc-script/wb-script are run (spawn, coprocess) */
+  int script_mode;
+
+  /* attach GstMarkerDetectMeta to the buffers */
+  bool attach_meta;
+
+  /* what is drawn on the frames (none, markers, full),
+     and how often the Color Checker values shown are updated (frames) */
+  int overlay;
+  unsigned overlay_refresh_interval;
+
+  /* stage timing, posted every stats_interval frames (0 = disabled) */
+  unsigned stats_interval;
+  GstMarkerDetectStats *stats;
+
+  /* chart_src request pad (rectified chart), reconfigured when pending */
+  GstPad *chart_pad;
+  bool chart_pad_pending;
+
+  GstMarkerDetectContext *context;
 };
 
 struct _GstMarkerDetectClass
@@ -0,0 +1,131 @@
+/* 
+ * Copyright 2025 Tria Technologies Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "gstmarkerdetectmeta.h"
+
+GType
+gst_markerdetect_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = {
+    GST_META_TAG_VIDEO_STR, GST_META_TAG_VIDEO_SIZE_STR, GST_META_TAG_VIDEO_ORIENTATION_STR, NULL
+  };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstMarkerDetectMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return (GType) type;
+}
+
+static gboolean
+gst_markerdetect_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  GstMarkerDetectMeta *dmeta = (GstMarkerDetectMeta *) meta;
+
+  memset ((guint8 *) dmeta + sizeof (GstMeta), 0, sizeof (GstMarkerDetectMeta) - sizeof (GstMeta));
+
+  return TRUE;
+}
+
+/* scale the frame coordinates by (sx, sy) */
+static void
+gst_markerdetect_meta_scale (GstMarkerDetectMeta *dmeta, gdouble sx, gdouble sy)
+{
+  for ( guint i = 0; i < dmeta->n_markers; i++ )
+  {
+    for ( int k = 0; k < 4; k++ )
+    {
+      dmeta->marker_corners[i][k][0] *= sx;
+      dmeta->marker_corners[i][k][1] *= sy;
+    }
+  }
+  // frame = diag(sx,sy,1) * H * reference
+  for ( int j = 0; j < 3; j++ )
+  {
+    dmeta->homography[0][j] *= sx;
+    dmeta->homography[1][j] *= sy;
+  }
+}
+
+static gboolean
+gst_markerdetect_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstMarkerDetectMeta *smeta = (GstMarkerDetectMeta *) meta;
+  GstMarkerDetectMeta *dmeta;
+
+  if (GST_META_TRANSFORM_IS_COPY (type)) {
+    GstMetaTransformCopy *copy = (GstMetaTransformCopy *) data;
+
+    // a partial (memory region) copy no longer holds the whole frame
+    if (copy->region)
+      return TRUE;
+
+    dmeta = gst_buffer_add_markerdetect_meta (dest);
+    if (!dmeta)
+      return FALSE;
+    memcpy ((guint8 *) dmeta + sizeof (GstMeta), (guint8 *) smeta + sizeof (GstMeta),
+        sizeof (GstMarkerDetectMeta) - sizeof (GstMeta));
+  } else if (GST_VIDEO_META_TRANSFORM_IS_SCALE (type)) {
+    GstVideoMetaTransform *trans = (GstVideoMetaTransform *) data;
+
+    dmeta = gst_buffer_add_markerdetect_meta (dest);
+    if (!dmeta)
+      return FALSE;
+    memcpy ((guint8 *) dmeta + sizeof (GstMeta), (guint8 *) smeta + sizeof (GstMeta),
+        sizeof (GstMarkerDetectMeta) - sizeof (GstMeta));
+    gst_markerdetect_meta_scale (dmeta,
+        (gdouble) GST_VIDEO_INFO_WIDTH (trans->out_info) / GST_VIDEO_INFO_WIDTH (trans->in_info),
+        (gdouble) GST_VIDEO_INFO_HEIGHT (trans->out_info) / GST_VIDEO_INFO_HEIGHT (trans->in_info));
+  } else {
+    // unknown transform : drop the meta
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+const GstMetaInfo *
+gst_markerdetect_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (GST_MARKERDETECT_META_API_TYPE,
+        "GstMarkerDetectMeta", sizeof (GstMarkerDetectMeta),
+        gst_markerdetect_meta_init, (GstMetaFreeFunction) NULL,
+        gst_markerdetect_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+  }
+  return meta_info;
+}
+
+GstMarkerDetectMeta *
+gst_buffer_add_markerdetect_meta (GstBuffer *buffer)
+{
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  return (GstMarkerDetectMeta *) gst_buffer_add_meta (buffer, GST_MARKERDETECT_META_INFO, NULL);
+}
@@ -0,0 +1,78 @@
+/* 
+ * Copyright 2025 Tria Technologies Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GST_MARKERDETECT_META_H_
+#define _GST_MARKERDETECT_META_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_MARKERDETECT_META_API_TYPE   (gst_markerdetect_meta_api_get_type())
+#define GST_MARKERDETECT_META_INFO   (gst_markerdetect_meta_get_info())
+
+#define gst_buffer_get_markerdetect_meta(b)   \
+  ((GstMarkerDetectMeta *) gst_buffer_get_meta ((b), GST_MARKERDETECT_META_API_TYPE))
+
+/* markers beyond this count are not carried by the meta (n_markers is clamped) */
+#define GST_MARKERDETECT_META_MAX_MARKERS 32
+
+typedef struct _GstMarkerDetectMeta GstMarkerDetectMeta;
+
+/**
+ * GstMarkerDetectMeta:
+ *
+ * Detection and chart analysis results of a frame, attached by markerdetect.
+ * All coordinates are frame pixels (x, y), and follow the frame when it is
+ * scaled. A crop that only adds a GstVideoCropMeta leaves them relative to
+ * the uncropped frame.
+ */
+struct _GstMarkerDetectMeta
+{
+  GstMeta meta;
+
+  /* detected markers, corners in ArUco order (tl, tr, br, bl) */
+  guint n_markers;
+  gint marker_ids[GST_MARKERDETECT_META_MAX_MARKERS];
+  gfloat marker_corners[GST_MARKERDETECT_META_MAX_MARKERS][4][2];
+
+  /* 0 (none), 1001 (color checker), 1002 (white reference), 1003 (histogram) */
+  gint chart;
+
+  /* chart reference coordinates to frame pixels (row major, valid when chart != 0) */
+  gdouble homography[3][3];
+
+  /* chart 1001 : B,G,R patch means, E[UV] patch errors, chart errors
+     (BGR, YUV, LAB, HSV, XYZ : total, then per component) */
+  gfloat patch_means[24][3];
+  gfloat patch_errors[24];
+  gfloat chart_errors[5][4];
+
+  /* chart 1002 : B,G,R mean of the white reference */
+  gfloat wb_mean[3];
+
+  /* chart 1003 : histograms (B,G,R, or Y,U,V for the YUV formats) and pixel count */
+  gint hist_count;
+  gfloat hist[3][256];
+};
+
+GType gst_markerdetect_meta_api_get_type (void);
+const GstMetaInfo *gst_markerdetect_meta_get_info (void);
+GstMarkerDetectMeta *gst_buffer_add_markerdetect_meta (GstBuffer *buffer);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2025 Tria Technologies Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gstmarkerdetectsampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/* SIMD deinterleaving for the BGR histogram kernel */
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+//
+// Polygon sampling
+//
+// Quads are sampled scanline by scanline over the rows they cover only : each
+// row contributes the span between the quad edges (pixel centers on integer
+// coordinates, both edge pixels included, as drawn by cv::fillPoly). No mask is
+// needed, so the cost follows the quad area rather than the frame size.
+//
+
+/* round to the nearest integer (as cvRound) */
+static inline int
+gst_markerdetect_round (float v)
+{
+  return (int) lrintf(v);
+}
+
+/* rows covered by a quad (rounded like its edge pixels, clipped to the plane) */
+static void
+gst_markerdetect_quad_rows (const GstMarkerDetectPoint quad[4], int rows, int *y0, int *y1)
+{
+  float ymin = std::min(std::min(quad[0].y, quad[1].y), std::min(quad[2].y, quad[3].y));
+  float ymax = std::max(std::max(quad[0].y, quad[1].y), std::max(quad[2].y, quad[3].y));
+
+  *y0 = std::max(gst_markerdetect_round(ymin), 0);
+  *y1 = std::min(gst_markerdetect_round(ymax), rows-1);
+}
+
+/* span [xl,xr] of a convex quad on a row (clipped to the plane) ; false if empty
+   (the edge pixels of the row are the ones of its edges within half a row, as cv::fillPoly
+   draws the edges as lines : a shallow edge covers a run of pixels on each row) */
+static bool
+gst_markerdetect_quad_span (const GstMarkerDetectPoint quad[4], int row, int cols, int *xl, int *xr)
+{
+  float bandTop = (float)row - 0.5f;
+  float bandBottom = (float)row + 0.5f;
+  float xmin = 0, xmax = 0;
+  bool hit = false;
+
+  for ( int i = 0; i < 4; i++ )
+  {
+    const GstMarkerDetectPoint &a = quad[i];
+    const GstMarkerDetectPoint &b = quad[(i+1) & 3];
+    // part of the edge within the row band (a single point for steep edges, one pixel per row)
+    float y0 = std::max(std::min(a.y, b.y), bandTop);
+    float y1 = std::min(std::max(a.y, b.y), bandBottom);
+    if ( y0 > y1 )
+      continue;
+    if ( std::fabs(b.x - a.x) <= std::fabs(b.y - a.y) )
+      y0 = y1 = std::min(std::max((float)row, y0), y1);
+    // horizontal edges cover both of their ends
+    float xa = a.x, xb = b.x;
+    if ( a.y != b.y )
+    {
+      float slope = (b.x - a.x) / (b.y - a.y);
+      xa = a.x + (y0 - a.y) * slope;
+      xb = a.x + (y1 - a.y) * slope;
+    }
+    if ( !hit )
+    {
+      xmin = std::min(xa, xb);
+      xmax = std::max(xa, xb);
+      hit = true;
+    }
+    else
+    {
+      xmin = std::min(xmin, std::min(xa, xb));
+      xmax = std::max(xmax, std::max(xa, xb));
+    }
+  }
+  if ( !hit )
+    return false;
+
+  *xl = std::max(gst_markerdetect_round(xmin), 0);
+  *xr = std::min(gst_markerdetect_round(xmax), cols-1);
+  return (*xl <= *xr);
+}
+
+/* per channel sums inside a quad (up to 4 channels) ; returns the pixel count */
+static int
+gst_markerdetect_quad_sum (const GstMarkerDetectPlane *plane, const GstMarkerDetectPoint quad[4], double sums[4])
+{
+  int cn = plane->channels;
+  int count = 0;
+  int y0, y1;
+
+  sums[0] = sums[1] = sums[2] = sums[3] = 0;
+  gst_markerdetect_quad_rows(quad, plane->rows, &y0, &y1);
+  for ( int y = y0; y <= y1; y++ )
+  {
+    int xl, xr;
+    if ( !gst_markerdetect_quad_span(quad, y, plane->cols, &xl, &xr) )
+      continue;
+    // 8-bit sums of a single row can not overflow 32 bits
+    unsigned rowSums[4] = { 0, 0, 0, 0 };
+    const uint8_t *p = plane->data + (size_t)y*plane->stride + xl*cn;
+    int n = xr - xl + 1;
+    for ( int x = 0; x < n; x++, p += cn )
+    {
+      for ( int c = 0; c < cn; c++ )
+        rowSums[c] += p[c];
+    }
+    for ( int c = 0; c < cn; c++ )
+      sums[c] += rowSums[c];
+    count += n;
+  }
+  return count;
+}
+
+/* 256-bin histogram of one channel inside a quad, accumulated into hist */
+static void
+gst_markerdetect_quad_hist (const GstMarkerDetectPlane *plane, const GstMarkerDetectPoint quad[4], int channel, float hist[256])
+{
+  int cn = plane->channels;
+  int y0, y1;
+
+  gst_markerdetect_quad_rows(quad, plane->rows, &y0, &y1);
+  for ( int y = y0; y <= y1; y++ )
+  {
+    int xl, xr;
+    if ( !gst_markerdetect_quad_span(quad, y, plane->cols, &xl, &xr) )
+      continue;
+    const uint8_t *p = plane->data + (size_t)y*plane->stride + xl*cn + channel;
+    for ( int x = xl; x <= xr; x++, p += cn )
+      hist[*p] += 1.0f;
+  }
+}
+
+/* B,G,R histograms of a row of interleaved BGR pixels, in a single pass ;
+   consecutive pixels go to 4 sub-histograms, so that repeated values
+   (flat chart areas) do not serialize on the same counters */
+static inline void
+gst_markerdetect_bgr_hist_row (const uint8_t *p, int n, unsigned sub[4][3][256])
+{
+  int x = 0;
+
+#if defined(__ARM_NEON) || defined(__SSSE3__)
+  uint8_t b[16], g[16], r[16];
+  for ( ; x + 16 <= n; x += 16, p += 48 )
+  {
+#if defined(__ARM_NEON)
+    uint8x16x3_t v = vld3q_u8(p);
+    vst1q_u8(b, v.val[0]);
+    vst1q_u8(g, v.val[1]);
+    vst1q_u8(r, v.val[2]);
+#else
+    __m128i v0 = _mm_loadu_si128((const __m128i *)(p));
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(p + 16));
+    __m128i v2 = _mm_loadu_si128((const __m128i *)(p + 32));
+    // gather every third byte of the 48 bytes (-1 clears the lane)
+    __m128i vb = _mm_or_si128(_mm_or_si128(
+      _mm_shuffle_epi8(v0, _mm_setr_epi8( 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1)),
+      _mm_shuffle_epi8(v1, _mm_setr_epi8(-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14,-1,-1,-1,-1,-1))),
+      _mm_shuffle_epi8(v2, _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 1, 4, 7,10,13)));
+    __m128i vg = _mm_or_si128(_mm_or_si128(
+      _mm_shuffle_epi8(v0, _mm_setr_epi8( 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1)),
+      _mm_shuffle_epi8(v1, _mm_setr_epi8(-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15,-1,-1,-1,-1,-1))),
+      _mm_shuffle_epi8(v2, _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 2, 5, 8,11,14)));
+    __m128i vr = _mm_or_si128(_mm_or_si128(
+      _mm_shuffle_epi8(v0, _mm_setr_epi8( 2, 5, 8,11,14,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1)),
+      _mm_shuffle_epi8(v1, _mm_setr_epi8(-1,-1,-1,-1,-1, 1, 4, 7,10,13,-1,-1,-1,-1,-1,-1))),
+      _mm_shuffle_epi8(v2, _mm_setr_epi8(-1,-1,-1,-1,-1,-1,-1,-1,-1,-1, 0, 3, 6, 9,12,15)));
+    _mm_storeu_si128((__m128i *)b, vb);
+    _mm_storeu_si128((__m128i *)g, vg);
+    _mm_storeu_si128((__m128i *)r, vr);
+#endif
+    for ( int k = 0; k < 16; k += 4 )
+    {
+      sub[0][0][b[k  ]]++; sub[0][1][g[k  ]]++; sub[0][2][r[k  ]]++;
+      sub[1][0][b[k+1]]++; sub[1][1][g[k+1]]++; sub[1][2][r[k+1]]++;
+      sub[2][0][b[k+2]]++; sub[2][1][g[k+2]]++; sub[2][2][r[k+2]]++;
+      sub[3][0][b[k+3]]++; sub[3][1][g[k+3]]++; sub[3][2][r[k+3]]++;
+    }
+  }
+#endif
+
+  for ( ; x + 4 <= n; x += 4, p += 12 )
+  {
+    sub[0][0][p[0]]++; sub[0][1][p[ 1]]++; sub[0][2][p[ 2]]++;
+    sub[1][0][p[3]]++; sub[1][1][p[ 4]]++; sub[1][2][p[ 5]]++;
+    sub[2][0][p[6]]++; sub[2][1][p[ 7]]++; sub[2][2][p[ 8]]++;
+    sub[3][0][p[9]]++; sub[3][1][p[10]]++; sub[3][2][p[11]]++;
+  }
+  for ( ; x < n; x++, p += 3 )
+  {
+    sub[0][0][p[0]]++; sub[0][1][p[1]]++; sub[0][2][p[2]]++;
+  }
+}
+
+/* B,G,R histograms (256 bins) inside a quad, reading the interleaved BGR plane once */
+static void
+gst_markerdetect_quad_hist_bgr (const GstMarkerDetectPlane *plane, const GstMarkerDetectPoint quad[4], float hist[3][256])
+{
+  unsigned sub[4][3][256];
+  int y0, y1;
+
+  memset(sub, 0, sizeof(sub));
+  gst_markerdetect_quad_rows(quad, plane->rows, &y0, &y1);
+  for ( int y = y0; y <= y1; y++ )
+  {
+    int xl, xr;
+    if ( !gst_markerdetect_quad_span(quad, y, plane->cols, &xl, &xr) )
+      continue;
+    gst_markerdetect_bgr_hist_row(plane->data + (size_t)y*plane->stride + xl*3, xr - xl + 1, sub);
+  }
+  for ( int c = 0; c < 3; c++ )
+  {
+    for ( int i = 0; i < 256; i++ )
+      hist[c][i] += sub[0][c][i] + sub[1][c][i] + sub[2][c][i] + sub[3][c][i];
+  }
+}
+
+/* the quad on a subsampled plane : (x/sx, y/sy) */
+static void
+gst_markerdetect_quad_subsample (const GstMarkerDetectPoint quad[4], float sx, float sy, GstMarkerDetectPoint sub[4])
+{
+  for ( int i = 0; i < 4; i++ )
+  {
+    sub[i].x = quad[i].x / sx;
+    sub[i].y = quad[i].y / sy;
+  }
+}
+
+int
+gst_markerdetect_sample_mean (GstMarkerDetectLayout layout, const GstMarkerDetectPlane planes[2],
+    const GstMarkerDetectPoint quad[4], double means[3], int *count)
+{
+  GstMarkerDetectPoint sub[4];
+  double sums[4];
+  int n;
+  int components = 3;
+
+  switch ( layout )
+  {
+  case GST_MARKERDETECT_LAYOUT_YUY2:
+    // YUYV pairs : the quad maps to (x/2,y), both Y samples of a pair count
+    gst_markerdetect_quad_subsample(quad, 2.0f, 1.0f, sub);
+    n = gst_markerdetect_quad_sum(&planes[0], sub, sums);
+    means[0] = (sums[0] + sums[2]) / (2*std::max(n, 1));
+    means[1] = sums[1] / std::max(n, 1);
+    means[2] = sums[3] / std::max(n, 1);
+    break;
+  case GST_MARKERDETECT_LAYOUT_NV12:
+    n = gst_markerdetect_quad_sum(&planes[0], quad, sums);
+    means[0] = sums[0] / std::max(n, 1);
+    // half resolution UV plane : the quad maps to (x/2,y/2)
+    gst_markerdetect_quad_subsample(quad, 2.0f, 2.0f, sub);
+    {
+      int uvCount = std::max(gst_markerdetect_quad_sum(&planes[1], sub, sums), 1);
+      means[1] = sums[0] / uvCount;
+      means[2] = sums[1] / uvCount;
+    }
+    break;
+  case GST_MARKERDETECT_LAYOUT_GRAY8:
+    n = gst_markerdetect_quad_sum(&planes[0], quad, sums);
+    means[0] = means[1] = means[2] = sums[0] / std::max(n, 1);
+    components = 1;
+    break;
+  case GST_MARKERDETECT_LAYOUT_BGR:
+  default:
+    n = gst_markerdetect_quad_sum(&planes[0], quad, sums);
+    for ( int c = 0; c < 3; c++ )
+      means[c] = sums[c] / std::max(n, 1);
+    break;
+  }
+
+  if ( count != NULL )
+    *count = n;
+  return components;
+}
+
+int
+gst_markerdetect_sample_histograms (GstMarkerDetectLayout layout, const GstMarkerDetectPlane planes[2],
+    const GstMarkerDetectPoint quad[4], float hist[3][256])
+{
+  GstMarkerDetectPoint sub[4];
+
+  memset(hist, 0, 3*256*sizeof(float));
+
+  switch ( layout )
+  {
+  case GST_MARKERDETECT_LAYOUT_YUY2:
+    // YUYV pairs : both Y samples of a pair go into the Y histogram
+    gst_markerdetect_quad_subsample(quad, 2.0f, 1.0f, sub);
+    gst_markerdetect_quad_hist(&planes[0], sub, 0, hist[0]);
+    gst_markerdetect_quad_hist(&planes[0], sub, 2, hist[0]);
+    gst_markerdetect_quad_hist(&planes[0], sub, 1, hist[1]);
+    gst_markerdetect_quad_hist(&planes[0], sub, 3, hist[2]);
+    return 3;
+  case GST_MARKERDETECT_LAYOUT_NV12:
+    gst_markerdetect_quad_hist(&planes[0], quad, 0, hist[0]);
+    gst_markerdetect_quad_subsample(quad, 2.0f, 2.0f, sub);
+    gst_markerdetect_quad_hist(&planes[1], sub, 0, hist[1]);
+    gst_markerdetect_quad_hist(&planes[1], sub, 1, hist[2]);
+    return 3;
+  case GST_MARKERDETECT_LAYOUT_GRAY8:
+    gst_markerdetect_quad_hist(&planes[0], quad, 0, hist[0]);
+    return 1;
+  case GST_MARKERDETECT_LAYOUT_BGR:
+  default:
+    gst_markerdetect_quad_hist_bgr(&planes[0], quad, hist);
+    return 3;
+  }
+}
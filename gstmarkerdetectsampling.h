@@ -0,0 +1,69 @@
+/*
+ * Copyright 2025 Tria Technologies Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _GST_MARKERDETECT_SAMPLING_H_
+#define _GST_MARKERDETECT_SAMPLING_H_
+
+/* Quad sampling on the native frame planes. Only depends on the C library, so
+   that test/sampling_markerdetect.py can build it alone and check it against
+   OpenCV (cv::fillPoly masks). */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* 8-bit plane of interleaved channels (1 to 4) */
+typedef struct
+{
+  const uint8_t *data;
+  int stride;                           /* bytes per row */
+  int cols;
+  int rows;
+  int channels;
+} GstMarkerDetectPlane;
+
+/* quad corner (pixel centers on integer coordinates) */
+typedef struct
+{
+  float x;
+  float y;
+} GstMarkerDetectPoint;
+
+/* plane layouts sampled */
+typedef enum
+{
+  GST_MARKERDETECT_LAYOUT_BGR,          /* planes[0] : B,G,R */
+  GST_MARKERDETECT_LAYOUT_GRAY8,        /* planes[0] : Y */
+  GST_MARKERDETECT_LAYOUT_NV12,         /* planes[0] : Y, planes[1] : U,V (half size) */
+  GST_MARKERDETECT_LAYOUT_YUY2          /* planes[0] : Y0,U,Y1,V pairs (half width) */
+} GstMarkerDetectLayout;
+
+/* mean components inside a convex quad (B,G,R, or Y,U,V, or Y) ; returns the number of
+   components, and the pixel count of the first plane in count (if not NULL) */
+int gst_markerdetect_sample_mean (GstMarkerDetectLayout layout, const GstMarkerDetectPlane planes[2],
+    const GstMarkerDetectPoint quad[4], double means[3], int *count);
+
+/* 256-bin histograms inside a convex quad (B,G,R, or Y,U,V, or Y) ; returns the number of histograms */
+int gst_markerdetect_sample_histograms (GstMarkerDetectLayout layout, const GstMarkerDetectPlane planes[2],
+    const GstMarkerDetectPoint quad[4], float hist[3][256]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
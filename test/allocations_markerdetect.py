@@ -0,0 +1,124 @@
+'''
+Copyright 2025 Tria Technologies Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+'''
+
+# Allocation check : synthetic chart frames (see synth_charts.py) are pushed
+# through appsrc ! markerdetect ! fakesink, on a plugin built with
+# make COUNT_ALLOCATIONS=1 (-DMARKERDETECT_COUNT_ALLOCATIONS), and with
+# libmarkerdetectalloc.so preloaded to count the heap allocations of each thread.
+# Past the first 50 frames, the element must not allocate at all : any heap
+# allocation on the frame path (heap-allocations in the stats structure) fails the run.
+#
+# The same frame is pushed, so the chart geometry is detected once and reused
+# (detect-interval) : the ArUco detector allocates on each call, so frames that
+# run it (empty scene, moving chart, detect-interval=1) fail the check. The
+# element message (post-messages) and the buffer meta (attach-meta) are
+# GStreamer objects allocated for each frame, and are disabled.
+
+import numpy as np
+import argparse
+import json
+import sys
+
+import gi
+gi.require_version('Gst', '1.0')
+from gi.repository import Gst
+
+import synth_charts
+
+
+# USAGE
+# LD_PRELOAD=../libmarkerdetectalloc.so GST_PLUGIN_PATH=.. python3 allocations_markerdetect.py [--resolution 640x480] [--charts 1001,1002,1003]
+#                  [--format BGR] [--frames 200] [--props "overlay=full"]
+
+ap = argparse.ArgumentParser()
+ap.add_argument("-r", "--resolution", required=False, default="640x480",
+  help = "resolution (640x480, 1080p, 4k) (default = 640x480)")
+ap.add_argument("-c", "--charts", required=False, default="1001,1002,1003",
+  help = "comma separated chart ids, 0 = empty scene (default = 1001,1002,1003)")
+ap.add_argument("-f", "--format", required=False, default="BGR",
+  help = "video format : BGR, NV12 or GRAY8 (default = BGR)")
+ap.add_argument("-n", "--frames", required=False, type=int, default=200,
+  help = "frames per run, the first 50 are not checked (default = 200)")
+ap.add_argument("-p", "--props", required=False, default="",
+  help = "extra markerdetect properties, e.g. \"overlay=full cc-show-ec=true\"")
+args = vars(ap.parse_args())
+
+# the element only checks its allocations after 50 frames
+warmup_frames = 50
+
+Gst.init(None)
+if Gst.ElementFactory.find("markerdetect") is None:
+  sys.exit("[ERROR] markerdetect plugin not found (set GST_PLUGIN_PATH)")
+
+def run(chart, width, height, format):
+  '''push the same frame through the element, return the stats'''
+  rng = np.random.default_rng(1)
+  if chart == 0:
+    frame = synth_charts.empty_frame(width, height, rng)
+  else:
+    frame = synth_charts.random_frame(synth_charts.load_chart(chart), width, height, rng)[0]
+  data = synth_charts.to_format(frame, format)
+
+  gst_pipeline = "appsrc name=src format=time"
+  gst_pipeline = gst_pipeline + " caps=video/x-raw,format=" + format + ",width=" + str(width) + ",height=" + str(height) + ",framerate=30/1"
+  gst_pipeline = gst_pipeline + " ! markerdetect name=md stats-interval=" + str(args["frames"])
+  gst_pipeline = gst_pipeline + " detect-interval=" + str(args["frames"]) + " post-messages=false attach-meta=false " + args["props"]
+  gst_pipeline = gst_pipeline + " ! fakesink sync=false"
+  pipeline = Gst.parse_launch(gst_pipeline)
+  src = pipeline.get_by_name("src")
+  md = pipeline.get_by_name("md")
+  bus = pipeline.get_bus()
+
+  pipeline.set_state(Gst.State.PLAYING)
+  duration = Gst.util_uint64_scale_int(1, Gst.SECOND, 30)
+  for i in range(args["frames"]):
+    buffer = Gst.Buffer.new_wrapped(data)
+    buffer.pts = i * duration
+    buffer.duration = duration
+    src.emit("push-buffer", buffer)
+  src.emit("end-of-stream")
+  message = bus.timed_pop_filtered(Gst.CLOCK_TIME_NONE, Gst.MessageType.EOS | Gst.MessageType.ERROR)
+  if message.type == Gst.MessageType.ERROR:
+    err, debug = message.parse_error()
+    pipeline.set_state(Gst.State.NULL)
+    sys.exit("[ERROR] " + err.message)
+  stats = md.get_property("stats")
+  pipeline.set_state(Gst.State.NULL)
+  return stats
+
+width, height = synth_charts.resolutions[args["resolution"]]
+checked = args["frames"] - warmup_frames
+failed = 0
+for chart in [ int(c) for c in args["charts"].split(",") ]:
+  stats = run(chart, width, height, args["format"])
+  if not stats.has_field("heap-allocations"):
+    sys.exit("[ERROR] no allocation counts, build the plugin with make COUNT_ALLOCATIONS=1 and preload libmarkerdetectalloc.so")
+  allocations = stats.get_value("heap-allocations")
+  result = {
+    "chart" : chart,
+    "resolution" : args["resolution"],
+    "format" : args["format"],
+    "props" : args["props"],
+    "frames_checked" : checked,
+    "heap_allocations" : allocations,
+    "heap_allocations_per_frame" : allocations / checked if checked > 0 else 0.0,
+  }
+  print("[%s] %s" % ("PASS" if allocations == 0 else "FAIL", json.dumps(result, sort_keys=True)))
+  if allocations != 0:
+    failed += 1
+
+print("[INFO] %d run(s) failed" % failed)
+sys.exit(1 if failed else 0)
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2025 Tria Technologies Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Heap allocation counter for test/allocations_markerdetect.py (glibc).
+   Preloaded (LD_PRELOAD=libmarkerdetectalloc.so), it interposes the C
+   allocation functions, which operator new, cv::fastMalloc and g_malloc all
+   end up in, and counts the calls made by each thread. A plugin built with
+   -DMARKERDETECT_COUNT_ALLOCATIONS (make COUNT_ALLOCATIONS=1) reads the count
+   of its calling thread with markerdetect_heap_allocations(). */
+
+#include <errno.h>
+#include <stddef.h>
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+extern void *__libc_memalign (size_t alignment, size_t size);
+extern void *__libc_valloc (size_t size);
+
+/* static TLS : reading it never allocates */
+static __thread unsigned long long allocations __attribute__ ((tls_model ("initial-exec")));
+
+unsigned long long
+markerdetect_heap_allocations (void)
+{
+  return allocations;
+}
+
+void *
+malloc (size_t size)
+{
+  allocations++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  allocations++;
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  allocations++;
+  return __libc_realloc (ptr, size);
+}
+
+void *
+memalign (size_t alignment, size_t size)
+{
+  allocations++;
+  return __libc_memalign (alignment, size);
+}
+
+void *
+aligned_alloc (size_t alignment, size_t size)
+{
+  allocations++;
+  return __libc_memalign (alignment, size);
+}
+
+int
+posix_memalign (void **ptr, size_t alignment, size_t size)
+{
+  if ( (alignment % sizeof (void *)) != 0 || (alignment & (alignment - 1)) != 0 )
+    return EINVAL;
+  allocations++;
+  void *p = __libc_memalign (alignment, size);
+  if ( p == NULL && size != 0 )
+    return ENOMEM;
+  *ptr = p;
+  return 0;
+}
+
+void *
+valloc (size_t size)
+{
+  allocations++;
+  return __libc_valloc (size);
+}
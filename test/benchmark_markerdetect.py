@@ -0,0 +1,139 @@
+'''
+Copyright 2025 Tria Technologies Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+'''
+
+# Throughput benchmark : synthetic chart frames (see synth_charts.py) are pushed
+# as fast as possible through appsrc ! markerdetect ! fakesink, and fps, per-stage
+# times (stats property) and detection rate are reported as JSON lines.
+# Chart 0 is an empty scene (no chart), e.g. to measure presence-filter=true
+# against presence-filter=false on frames without markers.
+
+import numpy as np
+import argparse
+import json
+import platform
+import sys
+import time
+
+import gi
+gi.require_version('Gst', '1.0')
+from gi.repository import Gst
+
+import synth_charts
+
+
+# USAGE
+# GST_PLUGIN_PATH=.. python3 benchmark_markerdetect.py [--resolutions 640x480,1080p,4k] [--charts 0,1001,1002,1003]
+#                  [--format BGR] [--frames 300] [--variants 16] [--props "overlay=none"] [--output results.jsonl]
+
+# construct the argument parse and parse the arguments
+ap = argparse.ArgumentParser()
+ap.add_argument("-r", "--resolutions", required=False, default="640x480,1080p,4k",
+  help = "comma separated resolutions (640x480, 1080p, 4k) (default = all)")
+ap.add_argument("-c", "--charts", required=False, default="1001,1002,1003",
+  help = "comma separated chart ids, 0 = empty scene (default = 1001,1002,1003)")
+ap.add_argument("-f", "--format", required=False, default="BGR",
+  help = "video format : BGR, NV12 or GRAY8 (default = BGR)")
+ap.add_argument("-n", "--frames", required=False, type=int, default=300,
+  help = "frames per run (default = 300)")
+ap.add_argument("-v", "--variants", required=False, type=int, default=16,
+  help = "distinct synthetic frames per run, pushed in a loop (default = 16)")
+ap.add_argument("-s", "--seed", required=False, type=int, default=1,
+  help = "random seed (default = 1)")
+ap.add_argument("-p", "--props", required=False, default="",
+  help = "extra markerdetect properties, e.g. \"overlay=none async=true\"")
+ap.add_argument("-o", "--output", required=False,
+  help = "append the JSON lines to this file (default = stdout only)")
+args = vars(ap.parse_args())
+
+Gst.init(None)
+if Gst.ElementFactory.find("markerdetect") is None:
+  sys.exit("[ERROR] markerdetect plugin not found (set GST_PLUGIN_PATH)")
+
+def run(chart, resolution, format):
+  width, height = synth_charts.resolutions[resolution]
+  rng = np.random.default_rng(args["seed"])
+  if chart == 0:
+    frames = [ synth_charts.to_format(synth_charts.empty_frame(width, height, rng), format)
+               for i in range(args["variants"]) ]
+  else:
+    chart_image = synth_charts.load_chart(chart)
+    frames = [ synth_charts.to_format(synth_charts.random_frame(chart_image, width, height, rng)[0], format)
+               for i in range(args["variants"]) ]
+
+  gst_pipeline = "appsrc name=src format=time block=true max-bytes=" + str(4*len(frames[0]))
+  gst_pipeline = gst_pipeline + " caps=video/x-raw,format=" + format + ",width=" + str(width) + ",height=" + str(height) + ",framerate=30/1"
+  gst_pipeline = gst_pipeline + " ! markerdetect name=md stats-interval=" + str(args["frames"]) + " " + args["props"]
+  gst_pipeline = gst_pipeline + " ! fakesink sync=false"
+  pipeline = Gst.parse_launch(gst_pipeline)
+  src = pipeline.get_by_name("src")
+  md = pipeline.get_by_name("md")
+  bus = pipeline.get_bus()
+
+  pipeline.set_state(Gst.State.PLAYING)
+  duration = Gst.util_uint64_scale_int(1, Gst.SECOND, 30)
+  start = time.monotonic()
+  for i in range(args["frames"]):
+    buffer = Gst.Buffer.new_wrapped(frames[i % len(frames)])
+    buffer.pts = i * duration
+    buffer.duration = duration
+    src.emit("push-buffer", buffer)
+  src.emit("end-of-stream")
+  message = bus.timed_pop_filtered(Gst.CLOCK_TIME_NONE, Gst.MessageType.EOS | Gst.MessageType.ERROR)
+  elapsed = time.monotonic() - start
+  if message.type == Gst.MessageType.ERROR:
+    err, debug = message.parse_error()
+    pipeline.set_state(Gst.State.NULL)
+    sys.exit("[ERROR] " + err.message)
+
+  stats = md.get_property("stats")
+  pipeline.set_state(Gst.State.NULL)
+
+  # <stage>-p50/-p95/-p99/-max (ns) => stages[stage][p50...] (us)
+  stages = {}
+  for i in range(stats.n_fields()):
+    name = stats.nth_field_name(i)
+    stage, sep, stat = name.rpartition("-")
+    if stat in ("p50","p95","p99","max"):
+      stages.setdefault(stage, {})[stat] = stats.get_value(name) / 1000.0
+  analyzed = stats.get_value("frames")
+
+  return {
+    "chart" : chart,
+    "resolution" : resolution,
+    "width" : width,
+    "height" : height,
+    "format" : format,
+    "props" : args["props"],
+    "frames" : args["frames"],
+    "fps" : args["frames"] / elapsed,
+    "detection_rate" : (stats.get_value("charts") / analyzed) if analyzed else 0.0,
+    "stages_us" : stages,
+    "machine" : platform.machine(),
+    "gstreamer" : Gst.version_string(),
+  }
+
+output = open(args["output"], "a") if args.get("output") else None
+for resolution in args["resolutions"].split(","):
+  for chart in [ int(c) for c in args["charts"].split(",") ]:
+    result = run(chart, resolution, args["format"])
+    line = json.dumps(result, sort_keys=True)
+    print(line)
+    sys.stdout.flush()
+    if output:
+      output.write(line + "\n")
+      output.flush()
+if output:
+  output.close()
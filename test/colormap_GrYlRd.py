@@ -44,7 +44,7 @@ colormap_bgr = colormap_bgr[::-1,:]
 
 # Generate structure for use with C++
 print("// BGR values for GrYlRd colormap")
-print("std::vector<cv::Scalar> colormap_GrYlRd =")
+print("static const cv::Scalar colormap_GrYlRd[] =")
 print("{")
 for i in range(60):
   print("   { ", str(colormap_bgr[i,0]), ", ", str(colormap_bgr[i,1]), ", ", str(colormap_bgr[i,2]), " },")
@@ -43,8 +43,9 @@ IMX708_RES_H=864
 OUT_RES_W=960
 OUT_RES_H=540
 # Output format of the RPi camera pipelines (use a GStreamer pixel format from the dict above)
-#OUT_FORMAT=YUY2
-OUT_FORMAT=BGR
+# (markerdetect accepts BGR, NV12 and YUY2 natively, no videoconvert needed)
+OUT_FORMAT=YUY2
+#OUT_FORMAT=BGR
 # Frame rate (fps)
 FRM_RATE=30
 #--------------------------------------------------------------------------------
@@ -208,6 +209,13 @@ quadrants_bgr=(
         "plane-id=50 render-rectangle=\"<${OUT_RES_W},${OUT_RES_H},${OUT_RES_W},${OUT_RES_H}>\""
 )
 
+# Video mixer planes matching the output format
+if [ "$OUT_FORMAT" == "BGR" ]; then
+        quadrants=("${quadrants_bgr[@]}")
+else
+        quadrants=("${quadrants_yuyv[@]}")
+fi
+
 index=0
 
 # For each connected camera, add pipeline to gstreamer command
@@ -215,8 +223,8 @@ for media in "${!media_to_video_mapping[@]}"; do
         # Append the specific command for the current iteration to the full command
         full_command+=" v4l2src device=${media_to_video_mapping[$media]} io-mode=mmap"
         full_command+=" ! video/x-raw, width=${OUT_RES_W}, height=${OUT_RES_H}, format=${OUT_FORMAT}, framerate=${FRM_RATE}/1"
-        full_command+=" ! markerdetect wb-script=./rpicam_aaswb.sh wb-extra-args=${media_to_video_mapping[$media]} wb-skip-frames=0"
-        full_command+=" ! kmssink bus-id=${VMIX} ${quadrants_bgr[$index]} show-preroll-frame=false sync=false can-scale=false"
+        full_command+=" ! markerdetect async=true worker-pool=shared group=cams wb-script=./rpicam_aaswb.sh wb-extra-args=${media_to_video_mapping[$media]} wb-skip-frames=0"
+        full_command+=" ! kmssink bus-id=${VMIX} ${quadrants[$index]} show-preroll-frame=false sync=false can-scale=false"
 
         ((index++))
 done
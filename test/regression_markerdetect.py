@@ -0,0 +1,263 @@
+'''
+Copyright 2025 Tria Technologies Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+'''
+
+# Headless regression suite : the chart images are rendered through known
+# homographies and color casts (see synth_charts.py), and pushed through
+# appsrc ! markerdetect ! appsink. The measurements (element messages) are
+# checked against :
+#   - the known geometry : chart corners = homography x corners found in the chart image
+#   - the known cast     : white reference mean = mean of the cast chart image (clipped)
+#   - golden values      : corners, patch means, E[UV]/E[LAB] totals, white reference mean
+# and the per-frame time (stats property) is reported with each case.
+#
+# The golden values are (re)generated from a reference build with --update and
+# committed as golden/regression_markerdetect.json (with the build that produced
+# them, under "_provenance") ; without them the suite fails.
+
+import numpy as np
+import cv2
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+import gi
+gi.require_version('Gst', '1.0')
+from gi.repository import Gst
+
+import synth_charts
+
+
+# USAGE
+# GST_PLUGIN_PATH=.. python3 regression_markerdetect.py [--golden golden/regression_markerdetect.json] [--update] [--output report.jsonl]
+
+ap = argparse.ArgumentParser()
+ap.add_argument("-g", "--golden", required=False,
+  default=os.path.join(os.path.dirname(os.path.abspath(__file__)), "golden", "regression_markerdetect.json"),
+  help = "golden values (default = golden/regression_markerdetect.json)")
+ap.add_argument("-u", "--update", required=False, default=False, action="store_true",
+  help = "write the measured values as the new golden values")
+ap.add_argument("-p", "--props", required=False, default="",
+  help = "extra markerdetect properties, e.g. \"delta-e=ciede2000\"")
+ap.add_argument("-o", "--output", required=False,
+  help = "write the per-case report (JSON lines) to this file")
+args = vars(ap.parse_args())
+
+# tolerances
+corner_tol_gt = 3.0      # pixels, against the known homography
+corner_tol = 1.0         # pixels, against the golden values
+mean_tol = 2.0           # levels (0-255)
+error_tol = 1.0          # chart error units
+wb_cast_tol = 4.0        # levels, against the known cast
+
+# the element publishes measurements after 50 frames (sensor settling)
+warmup_frames = 50
+frames_per_case = warmup_frames + 4
+
+# chart poses : chart corners in the frame, relative to the frame size
+poses = {
+  "front" : [[0.30,0.08],[0.70,0.08],[0.70,0.92],[0.30,0.92]],
+  "left"  : [[0.25,0.12],[0.68,0.05],[0.70,0.95],[0.27,0.86]],
+  "right" : [[0.32,0.05],[0.74,0.13],[0.72,0.88],[0.30,0.95]],
+}
+
+# color casts : B,G,R gains
+casts = {
+  "neutral" : (1.00,1.00,1.00),
+  "warm"    : (0.85,1.00,1.15),
+  "cool"    : (1.15,1.00,0.85),
+}
+
+def cases():
+  for chart in (1001, 1002):
+    for pose in poses:
+      for cast in casts:
+        yield chart, "640x480", pose, cast
+    yield chart, "1080p", "front", "neutral"
+
+def pose_homography(chart_image, width, height, pose):
+  ch, cw = chart_image.shape[:2]
+  src = np.float32([[0,0],[cw,0],[cw,ch],[0,ch]])
+  dst = np.float32(poses[pose]) * np.float32([width,height])
+  return cv2.getPerspectiveTransform(src, dst)
+
+def chart_quad(chart_image, chart):
+  '''chart quad in the chart image (same marker corners as the element) : tl, tr, br, bl'''
+  dictionary = cv2.aruco.getPredefinedDictionary(cv2.aruco.DICT_ARUCO_ORIGINAL)
+  if hasattr(cv2.aruco, "ArucoDetector"):
+    corners, ids, rejected = cv2.aruco.ArucoDetector(dictionary).detectMarkers(chart_image)
+  else:
+    corners, ids, rejected = cv2.aruco.detectMarkers(chart_image, dictionary)
+  found = { int(i) : c.reshape(4,2) for i, c in zip(ids.flatten(), corners) }
+  return np.float32([ found[923][3], found[chart][2], found[241][1], found[1007][0] ])
+
+def quad_mean(image, quad):
+  mask = np.zeros(image.shape[:2], np.uint8)
+  cv2.fillConvexPoly(mask, np.int32(np.round(quad)), 255)
+  return np.array(cv2.mean(image, mask)[:3])
+
+def run(frame, width, height):
+  '''push the frame through the element, return the last measurement and the stats'''
+  gst_pipeline = "appsrc name=src format=time"
+  gst_pipeline = gst_pipeline + " caps=video/x-raw,format=BGR,width=" + str(width) + ",height=" + str(height) + ",framerate=30/1"
+  gst_pipeline = gst_pipeline + " ! markerdetect name=md stats-interval=" + str(frames_per_case) + " overlay=none " + args["props"]
+  gst_pipeline = gst_pipeline + " ! appsink name=sink sync=false"
+  pipeline = Gst.parse_launch(gst_pipeline)
+  src = pipeline.get_by_name("src")
+  sink = pipeline.get_by_name("sink")
+  md = pipeline.get_by_name("md")
+  bus = pipeline.get_bus()
+
+  pipeline.set_state(Gst.State.PLAYING)
+  data = frame.tobytes()
+  duration = Gst.util_uint64_scale_int(1, Gst.SECOND, 30)
+  output_frames = 0
+  for i in range(frames_per_case):
+    buffer = Gst.Buffer.new_wrapped(data)
+    buffer.pts = i * duration
+    buffer.duration = duration
+    src.emit("push-buffer", buffer)
+    if sink.emit("pull-sample") is not None:
+      output_frames += 1
+  src.emit("end-of-stream")
+
+  measurement = None
+  while True:
+    message = bus.timed_pop_filtered(Gst.CLOCK_TIME_NONE, Gst.MessageType.EOS | Gst.MessageType.ERROR | Gst.MessageType.ELEMENT)
+    if message.type == Gst.MessageType.ERROR:
+      err, debug = message.parse_error()
+      pipeline.set_state(Gst.State.NULL)
+      sys.exit("[ERROR] " + err.message)
+    if message.type == Gst.MessageType.EOS:
+      break
+    s = message.get_structure()
+    if s is not None and s.get_name() == "markerdetect":
+      measurement = s
+  stats = md.get_property("stats")
+  pipeline.set_state(Gst.State.NULL)
+  return measurement, stats, output_frames
+
+def values(measurement):
+  '''measurement structure => plain values (golden file format)'''
+  v = { "chart" : measurement.get_value("chart"), "corners" : list(measurement.get_value("corners")) }
+  if v["chart"] == 1001:
+    v["means"] = list(measurement.get_value("means"))
+    v["error-uv"] = measurement.get_value("error-uv")
+    v["error-lab"] = measurement.get_value("error-lab")
+  if v["chart"] == 1002:
+    v["wb"] = [ measurement.get_value("b"), measurement.get_value("g"), measurement.get_value("r") ]
+  return v
+
+def compare(failures, name, measured, expected, tol):
+  diff = np.max(np.abs(np.array(measured, np.float64) - np.array(expected, np.float64)))
+  if diff > tol:
+    failures.append("%s off by %.2f (tolerance %.2f)" % (name, diff, tol))
+
+Gst.init(None)
+if Gst.ElementFactory.find("markerdetect") is None:
+  sys.exit("[ERROR] markerdetect plugin not found (set GST_PLUGIN_PATH)")
+
+golden = {}
+if os.path.exists(args["golden"]):
+  with open(args["golden"]) as f:
+    golden = json.load(f)
+elif not args["update"]:
+  sys.exit("[ERROR] no golden values (" + args["golden"] + "), run with --update on a reference build")
+
+report = open(args["output"], "w") if args.get("output") else None
+failed = 0
+for chart, resolution, pose, cast in cases():
+  name = "%d-%s-%s-%s" % (chart, resolution, pose, cast)
+  width, height = synth_charts.resolutions[resolution]
+  chart_image = synth_charts.load_chart(chart)
+  H = pose_homography(chart_image, width, height, pose)
+  rng = np.random.default_rng(1)
+  frame = synth_charts.render(chart_image, width, height, H, gains=casts[cast], blur=0.7, noise=2.0, rng=rng)
+
+  measurement, stats, output_frames = run(frame, width, height)
+  failures = []
+  measured = None
+  if output_frames != frames_per_case:
+    failures.append("%d frames out of %d" % (output_frames, frames_per_case))
+  if measurement is None or measurement.get_value("chart") != chart:
+    failures.append("chart not detected")
+  else:
+    measured = values(measurement)
+
+    # known geometry
+    quad = chart_quad(chart_image, chart)
+    expected_corners = cv2.perspectiveTransform(quad.reshape(-1,1,2), H).reshape(-1)
+    compare(failures, "corners (homography)", measured["corners"], expected_corners, corner_tol_gt * width / 640)
+
+    # known cast
+    if chart == 1002:
+      # (the cast is applied per pixel, and the white reference clips at 255)
+      cast_image = np.clip(chart_image * np.float32(casts[cast]), 0, 255)
+      expected_wb = quad_mean(cast_image, quad)
+      compare(failures, "white reference (cast)", measured["wb"], expected_wb, wb_cast_tol)
+
+    # golden values
+    if args["update"]:
+      golden[name] = measured
+    elif name not in golden:
+      failures.append("no golden values")
+    else:
+      g = golden[name]
+      compare(failures, "corners", measured["corners"], g["corners"], corner_tol * width / 640)
+      if chart == 1001:
+        compare(failures, "patch means", measured["means"], g["means"], mean_tol)
+        compare(failures, "E[UV]", [measured["error-uv"]], [g["error-uv"]], error_tol)
+        compare(failures, "E[LAB]", [measured["error-lab"]], [g["error-lab"]], error_tol)
+      if chart == 1002:
+        compare(failures, "white reference", measured["wb"], g["wb"], mean_tol)
+
+  result = {
+    "case" : name,
+    "pass" : not failures,
+    "failures" : failures,
+    "frame_p50_us" : stats.get_value("frame-p50") / 1000.0 if stats.has_field("frame-p50") else None,
+    "frame_max_us" : stats.get_value("frame-max") / 1000.0 if stats.has_field("frame-max") else None,
+    "measured" : measured,
+  }
+  print("[%s] %s %s" % ("PASS" if not failures else "FAIL", name, "; ".join(failures)))
+  if report:
+    report.write(json.dumps(result, sort_keys=True) + "\n")
+  if failures:
+    failed += 1
+
+if report:
+  report.close()
+if args["update"] and failed:
+  print("[ERROR] golden values not written, fix the failing case(s) first")
+elif args["update"]:
+  # which build produced the values (plugin file and version, source tree, OpenCV of this script)
+  plugin = Gst.ElementFactory.find("markerdetect").get_plugin()
+  source = subprocess.run(["git", "describe", "--always", "--dirty"], cwd=os.path.dirname(os.path.abspath(__file__)),
+                          capture_output=True, text=True).stdout.strip()
+  golden["_provenance"] = {
+    "plugin" : os.path.basename(plugin.get_filename()) + " " + plugin.get_version(),
+    "source" : source,
+    "opencv-python" : cv2.__version__,
+    "props" : args["props"],
+  }
+  os.makedirs(os.path.dirname(args["golden"]), exist_ok=True)
+  with open(args["golden"], "w") as f:
+    json.dump(golden, f, indent=1, sort_keys=True)
+  print("[INFO] golden values written to", args["golden"])
+
+print("[INFO] %d case(s) failed" % failed)
+sys.exit(1 if failed else 0)
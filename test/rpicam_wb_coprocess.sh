@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# White Balance script for script-mode=coprocess :
+# started once, reads one "b g r" line per measurement on stdin
+
+dev=$1
+
+while read b_mean g_mean r_mean; do
+	echo "[$dev] Color averages (B/G/R) = $b_mean/$g_mean/$r_mean"
+done
@@ -0,0 +1,295 @@
+'''
+Copyright 2025 Tria Technologies Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+'''
+
+# Sampling check : the quad sampler (gstmarkerdetectsampling.cpp, built here
+# with the host compiler, no GStreamer needed) is compared with cv2.fillPoly
+# masks, cv2.mean and cv2.calcHist, on random convex quads (integer and
+# sub-pixel corners, inside the frame and across its edges), for the BGR,
+# GRAY8, NV12 and YUY2 plane layouts.
+#
+# The sampler and fillPoly may only disagree on outline pixels : the pixels
+# of each plane that differ from the fillPoly mask (measured by sampling the
+# mask itself) must stay under a fraction of the quad outline, and the means
+# and histograms must then match up to what those pixels can move. fillPoly
+# rounds the corners of its edge lines to whole pixels, so fractional corners
+# (sub-pixel quads, and the half resolution chroma planes) get more slack.
+# The fillPoly reference is drawn on a padded canvas, so that it is not
+# affected by OpenCV clipping the quad edges to the frame.
+
+import numpy as np
+import cv2
+import argparse
+import ctypes
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+
+# USAGE
+# python3 sampling_markerdetect.py [--quads 500] [--seed 1] [--size 160x120]
+
+ap = argparse.ArgumentParser()
+ap.add_argument("-q", "--quads", required=False, type=int, default=500,
+  help = "random quads per layout and corner kind (default = 500)")
+ap.add_argument("-s", "--seed", required=False, type=int, default=1,
+  help = "random seed (default = 1)")
+ap.add_argument("-r", "--size", required=False, default="160x120",
+  help = "frame size, even (default = 160x120)")
+args = vars(ap.parse_args())
+
+# pixels that may differ from the fillPoly mask, per pixel of outline (and a few
+# more for the corners), per quad and on average : whole pixel, fractional corners
+outline_tolerance = { True : 0.4, False : 1.0 }
+average_tolerance = { True : 0.12, False : 0.3 }
+corner_pixels = 4
+
+# fillPoly canvas padding (pixels)
+padding = 64
+
+here = os.path.dirname(os.path.abspath(__file__))
+
+
+#
+# Sampler library
+#
+
+class Plane(ctypes.Structure):
+  _fields_ = [("data", ctypes.c_void_p), ("stride", ctypes.c_int), ("cols", ctypes.c_int),
+              ("rows", ctypes.c_int), ("channels", ctypes.c_int)]
+
+class Point(ctypes.Structure):
+  _fields_ = [("x", ctypes.c_float), ("y", ctypes.c_float)]
+
+layouts = { "BGR" : 0, "GRAY8" : 1, "NV12" : 2, "YUY2" : 3 }
+
+def build_sampler(directory):
+  '''compile the sampler alone (same flags as the Makefile, native SIMD)'''
+  library = os.path.join(directory, "libmarkerdetectsampling.so")
+  command = [os.environ.get("CXX", "g++"), "-O2", "-ffast-math", "-fPIC", "-shared", "-std=c++17", "-march=native",
+             os.path.join(here, "..", "gstmarkerdetectsampling.cpp"), "-o", library]
+  subprocess.run(command, check=True)
+  sampler = ctypes.CDLL(library)
+  sampler.gst_markerdetect_sample_mean.restype = ctypes.c_int
+  sampler.gst_markerdetect_sample_histograms.restype = ctypes.c_int
+  return sampler
+
+def to_plane(array):
+  '''numpy view (rows, cols[, channels]) => Plane (row stride kept)'''
+  channels = 1 if array.ndim == 2 else array.shape[2]
+  return Plane(array.ctypes.data, array.strides[0], array.shape[1], array.shape[0], channels)
+
+def sample(sampler, layout, arrays, quad):
+  '''means, first plane pixel count and histograms of the sampler'''
+  planes = (Plane * 2)(to_plane(arrays[0]), to_plane(arrays[-1]))
+  corners = (Point * 4)(*[ Point(x, y) for x, y in quad ])
+  means = (ctypes.c_double * 3)()
+  count = ctypes.c_int()
+  hist = np.zeros((3, 256), np.float32)
+  sampler.gst_markerdetect_sample_mean(layouts[layout], planes, corners, means, ctypes.byref(count))
+  sampler.gst_markerdetect_sample_histograms(layouts[layout], planes, corners, hist.ctypes.data_as(ctypes.c_void_p))
+  return list(means), count.value, hist
+
+
+#
+# Frames and quads
+#
+
+def strided(rng, rows, cols, channels):
+  '''random plane content, as a view with padded rows'''
+  buffer = np.zeros((rows, cols + 13, channels), np.uint8)
+  plane = buffer[:, :cols, :]
+  # each channel has its own level and gradients, so that mixed up channels or
+  # misplaced (subsampled) quads do not average to the same values
+  y, x = np.mgrid[0:rows, 0:cols]
+  for c in range(channels):
+    level = 40 + 50 * c
+    gradient = level + (x * (c + 1) * 60.0 / cols) + (y * (channels - c) * 40.0 / rows)
+    plane[:, :, c] = np.clip(gradient + rng.integers(-25, 26, (rows, cols)), 0, 255)
+  return plane if channels > 1 else plane[:, :, 0]
+
+def frame(rng, layout, width, height):
+  '''native planes of a layout'''
+  if layout == "BGR":
+    return [ strided(rng, height, width, 3) ]
+  if layout == "GRAY8":
+    return [ strided(rng, height, width, 1) ]
+  if layout == "NV12":
+    return [ strided(rng, height, width, 1), strided(rng, height // 2, width // 2, 2) ]
+  return [ strided(rng, height, width // 2, 4) ]
+
+def convex(quad):
+  turns = [ (quad[(i+1)%4][0] - quad[i][0]) * (quad[(i+2)%4][1] - quad[(i+1)%4][1]) -
+            (quad[(i+1)%4][1] - quad[i][1]) * (quad[(i+2)%4][0] - quad[(i+1)%4][0]) for i in range(4) ]
+  return all(t > 0 for t in turns) or all(t < 0 for t in turns)
+
+def random_quad(rng, width, height, subpixel, edge):
+  '''random convex quad, centered inside the frame or around one of its edges'''
+  while True:
+    if edge:
+      side = rng.integers(4)
+      cx = [ 0, width - 1, rng.uniform(0, width - 1), rng.uniform(0, width - 1) ][side]
+      cy = [ rng.uniform(0, height - 1), rng.uniform(0, height - 1), 0, height - 1 ][side]
+    else:
+      cx, cy = rng.uniform(0, width - 1), rng.uniform(0, height - 1)
+    radius = rng.uniform(0.5, 0.4 * min(width, height))
+    angles = np.sort(rng.uniform(0, 2 * np.pi, 4))
+    quad = [ (cx + radius * rng.uniform(0.5, 1) * np.cos(a), cy + radius * rng.uniform(0.5, 1) * np.sin(a)) for a in angles ]
+    if not subpixel:
+      quad = [ (float(round(x)), float(round(y))) for x, y in quad ]
+    if convex(quad):
+      return quad
+
+def fixed_quads(width, height):
+  '''whole frame, edge rows/columns, outside the frame, single pixel, sub-pixel sliver'''
+  w, h = width - 1, height - 1
+  return [
+    [ (0, 0), (w, 0), (w, h), (0, h) ],
+    [ (-10, -10), (w + 10, -10), (w + 10, h + 10), (-10, h + 10) ],
+    [ (0, 0), (w, 0), (w, 3), (0, 3) ],
+    [ (w - 3, 0), (w, 0), (w, h), (w - 3, h) ],
+    [ (-20, -20), (-5, -20), (-5, -5), (-20, -5) ],
+    [ (10, 10), (10, 10), (10, 10), (10, 10) ],
+    [ (20.3, 30.2), (60.7, 30.4), (60.6, 30.9), (20.2, 30.7) ],
+  ]
+
+
+#
+# fillPoly reference
+#
+
+def reference_mask(quad, rows, cols):
+  '''fillPoly mask of a quad (sub-pixel corners), drawn unclipped'''
+  canvas = np.zeros((rows + 2 * padding, cols + 2 * padding), np.uint8)
+  points = np.round((np.array(quad) + padding) * 256).astype(np.int32)
+  cv2.fillPoly(canvas, [points], 255, lineType=cv2.LINE_8, shift=8)
+  return np.ascontiguousarray(canvas[padding:padding+rows, padding:padding+cols])
+
+def outline(quad):
+  return sum(np.hypot(quad[(i+1)%4][0] - quad[i][0], quad[(i+1)%4][1] - quad[i][1]) for i in range(4))
+
+def scaled(quad, sx, sy):
+  return [ (x / sx, y / sy) for x, y in quad ]
+
+def channel_plans(layout):
+  '''(plane, quad scale x, y, [(channel, mean index, histogram index)]) of each plane'''
+  if layout == "BGR":
+    return [ (0, 1, 1, [ (0, 0, 0), (1, 1, 1), (2, 2, 2) ]) ]
+  if layout == "GRAY8":
+    return [ (0, 1, 1, [ (0, 0, 0) ]) ]
+  if layout == "NV12":
+    return [ (0, 1, 1, [ (0, 0, 0) ]), (1, 2, 2, [ (0, 1, 1), (1, 2, 2) ]) ]
+  return [ (0, 2, 1, [ ((0, 2), 0, 0), (1, 1, 1), (3, 2, 2) ]) ]
+
+def check(sampler, layout, arrays, quad):
+  '''compare one quad ; returns (failures, [(whole pixel corners, outline mismatch ratio)] per plane)'''
+  failures = []
+  ratios = []
+  means, count, hist = sample(sampler, layout, arrays, quad)
+
+  for plane, sx, sy, channels in channel_plans(layout):
+    array = arrays[plane]
+    rows, cols = array.shape[:2]
+    planeQuad = scaled(quad, sx, sy)
+    mask = reference_mask(planeQuad, rows, cols)
+    inMask = int(np.count_nonzero(mask))
+
+    # pixels sampled, and sampled inside the mask : sample the mask itself
+    probe = []
+    for p, a in enumerate(arrays):
+      m = mask if p == plane else np.zeros(a.shape[:2], np.uint8)
+      probe.append(np.ascontiguousarray(np.repeat(m[:, :, None], a.shape[2], axis=2)) if a.ndim == 3 else m)
+    _, _, probeHist = sample(sampler, layout, probe, quad)
+    first = channels[0][2]
+    scale = 2 if isinstance(channels[0][0], tuple) else 1
+    sampled = int(probeHist[first].sum()) // scale
+    both = int(probeHist[first][255]) // scale
+    mismatch = sampled + inMask - 2 * both
+    whole = all(float(v).is_integer() for corner in planeQuad for v in corner)
+    allowed = outline_tolerance[whole] * (outline(planeQuad) + corner_pixels)
+    ratios.append((whole, mismatch / (outline(planeQuad) + corner_pixels)))
+    if mismatch > allowed:
+      failures.append("plane %d : %d pixels differ from the fillPoly mask (%d allowed)" % (plane, mismatch, int(allowed)))
+    if plane == 0 and count != sampled:
+      failures.append("pixel count %d, histogram count %d" % (count, sampled))
+
+    for channel, meanIndex, histIndex in channels:
+      picks = channel if isinstance(channel, tuple) else (channel,)
+      values = [ array[:, :, c] if array.ndim == 3 else array for c in picks ]
+      # mean : may only move by what the differing pixels can move it
+      if inMask > 0 and sampled > 0:
+        reference = np.mean([ cv2.mean(np.ascontiguousarray(v), mask)[0] for v in values ])
+        bound = 255.0 * mismatch / min(inMask, sampled) + 1e-6
+        if abs(means[meanIndex] - reference) > bound:
+          failures.append("plane %d channel %s : mean %.3f, fillPoly mean %.3f (%.3f allowed)" %
+                          (plane, picks, means[meanIndex], reference, bound))
+      elif sampled == 0 and means[meanIndex] != 0.0:
+        failures.append("plane %d channel %s : mean %.3f of no pixels" % (plane, picks, means[meanIndex]))
+      # histogram : each differing pixel moves one count (per channel picked)
+      reference = sum(cv2.calcHist([ np.ascontiguousarray(v) ], [0], mask, [256], [0, 256])[:, 0] for v in values)
+      distance = float(np.abs(hist[histIndex] - reference).sum())
+      if distance > mismatch * len(picks):
+        failures.append("plane %d channel %s : histogram distance %d (%d allowed)" %
+                        (plane, picks, distance, mismatch * len(picks)))
+
+  return failures, ratios
+
+
+width, height = [ int(v) for v in args["size"].split("x") ]
+if (width % 2) or (height % 2):
+  sys.exit("[ERROR] the frame size must be even")
+
+rng = np.random.default_rng(args["seed"])
+failed = 0
+with tempfile.TemporaryDirectory() as directory:
+  sampler = build_sampler(directory)
+  for layout in layouts:
+    for kind in [ "fixed", "integer", "integer-edge", "subpixel", "subpixel-edge" ]:
+      if kind == "fixed":
+        quads = fixed_quads(width, height)
+      else:
+        quads = [ random_quad(rng, width, height, kind.startswith("subpixel"), kind.endswith("edge"))
+                  for i in range(args["quads"]) ]
+      arrays = frame(rng, layout, width, height)
+      errors = []
+      ratios = []
+      for quad in quads:
+        failures, quadRatios = check(sampler, layout, arrays, quad)
+        ratios += quadRatios
+        errors += [ "%s : %s" % ([ (round(x, 2), round(y, 2)) for x, y in quad ], f) for f in failures ]
+      result = {
+        "layout" : layout,
+        "quads" : kind,
+        "count" : len(quads),
+      }
+      for whole in [ True, False ]:
+        values = [ r for w, r in ratios if w == whole ]
+        if not values:
+          continue
+        average = float(np.mean(values))
+        result["outline_mismatch_" + ("whole" if whole else "fractional")] = round(average, 4)
+        if average > average_tolerance[whole]:
+          errors.append("%.3f pixels differ from the fillPoly masks per pixel of outline on average (%.3f allowed)" %
+                        (average, average_tolerance[whole]))
+      print("[%s] %s" % ("FAIL" if errors else "PASS", json.dumps(result, sort_keys=True)))
+      for e in errors[:10]:
+        print("  " + e)
+      if errors:
+        failed += 1
+
+print("[INFO] %d run(s) failed" % failed)
+sys.exit(1 if failed else 0)
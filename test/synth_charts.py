@@ -0,0 +1,102 @@
+'''
+Copyright 2025 Tria Technologies Inc.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+'''
+
+# Synthetic frames built from the chart images in charts/ :
+# the chart is warped into the frame, then lit, blurred and noised.
+
+import os
+import numpy as np
+import cv2
+
+charts_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "charts")
+
+# chart id (top right marker) => chart image
+chart_files = {
+  1001 : "tria_chart1_colorchecker_classic.png",
+  1002 : "tria_chart2_white_reference.png",
+  1003 : "tria_chart3_histogram.png",
+}
+
+resolutions = {
+  "640x480"   : ( 640, 480),
+  "1080p"     : (1920,1080),
+  "4k"        : (3840,2160),
+}
+
+def load_chart(chart):
+  image = cv2.imread(os.path.join(charts_dir, chart_files[chart]), cv2.IMREAD_COLOR)
+  if image is None:
+    raise IOError("could not read " + chart_files[chart])
+  return image
+
+def random_homography(chart_image, width, height, rng, fill=(0.45,0.85), jitter=0.06):
+  '''chart image => frame, chart of random size/position with a random perspective'''
+  ch, cw = chart_image.shape[:2]
+  scale = rng.uniform(fill[0], fill[1]) * min(width/cw, height/ch)
+  w, h = cw*scale, ch*scale
+  cx = rng.uniform(w/2, width-w/2)
+  cy = rng.uniform(h/2, height-h/2)
+  src = np.float32([[0,0],[cw,0],[cw,ch],[0,ch]])
+  dst = np.float32([[cx-w/2,cy-h/2],[cx+w/2,cy-h/2],[cx+w/2,cy+h/2],[cx-w/2,cy+h/2]])
+  dst += np.float32(rng.uniform(-jitter, jitter, (4,2)) * [w,h])
+  return cv2.getPerspectiveTransform(src, dst)
+
+def render(chart_image, width, height, H, gains=(1.0,1.0,1.0), gradient=0.0, blur=0.0, noise=0.0, rng=None, background=96):
+  '''warp the chart into a BGR frame, with B,G,R gains (color cast), a left to right
+     illumination gradient, gaussian blur (sigma) and gaussian noise (sigma)'''
+  frame = np.full((height,width,3), background, np.uint8)
+  cv2.warpPerspective(chart_image, H, (width,height), dst=frame, flags=cv2.INTER_LINEAR, borderMode=cv2.BORDER_TRANSPARENT)
+  light = np.float32(gains).reshape(1,1,3) * np.linspace(1.0-gradient/2, 1.0+gradient/2, width, dtype=np.float32).reshape(1,width,1)
+  frame = frame.astype(np.float32) * light
+  if blur > 0:
+    frame = cv2.GaussianBlur(frame, (0,0), blur)
+  if noise > 0:
+    frame += rng.normal(0.0, noise, frame.shape).astype(np.float32)
+  return np.clip(frame + 0.5, 0, 255).astype(np.uint8)
+
+def random_frame(chart_image, width, height, rng):
+  '''one random synthetic frame (and its chart => frame homography)'''
+  H = random_homography(chart_image, width, height, rng)
+  gains = rng.uniform(0.8, 1.2, 3)
+  frame = render(chart_image, width, height, H, gains=gains,
+                 gradient=rng.uniform(0.0, 0.3), blur=rng.uniform(0.0, 1.5),
+                 noise=rng.uniform(0.0, 6.0), rng=rng)
+  return frame, H
+
+def empty_frame(width, height, rng):
+  '''one random synthetic frame without any chart (smooth clutter, lit, blurred and noised)'''
+  clutter = rng.uniform(40, 200, (height//32+1, width//32+1, 3)).astype(np.float32)
+  clutter = cv2.resize(clutter, (width,height), interpolation=cv2.INTER_CUBIC)
+  light = np.linspace(0.85, 1.15, width, dtype=np.float32).reshape(1,width,1)
+  frame = cv2.GaussianBlur(clutter * light, (0,0), rng.uniform(0.0, 1.5) + 0.1)
+  frame += rng.normal(0.0, rng.uniform(0.0, 6.0), frame.shape).astype(np.float32)
+  return np.clip(frame + 0.5, 0, 255).astype(np.uint8)
+
+def to_format(frame, format):
+  '''BGR frame => raw video bytes (default GStreamer strides for even sizes)'''
+  if format == "BGR":
+    return frame.tobytes()
+  if format == "GRAY8":
+    return cv2.cvtColor(frame, cv2.COLOR_BGR2GRAY).tobytes()
+  if format == "NV12":
+    height, width = frame.shape[:2]
+    i420 = cv2.cvtColor(frame, cv2.COLOR_BGR2YUV_I420)
+    y = i420[:height]
+    u = i420[height:height+height//4].reshape(height//2, width//2)
+    v = i420[height+height//4:].reshape(height//2, width//2)
+    uv = np.dstack((u,v)).reshape(height//2, width)
+    return np.vstack((y,uv)).tobytes()
+  raise ValueError("unsupported format " + format)